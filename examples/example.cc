@@ -1,9 +1,9 @@
-#include <utf8_scanner/utf8_scanner.h>
+#include <utf8_utils/utf8_utils.h>
 
 #include <iostream>
 
 int main() {
-  std::uint8_t byte = 0x80;
-  std::cout << std::boolalpha << utf8_scanner::IsAscii(byte) << std::endl;
+  const auto err = utf8_utils::Check("Hello, \xffworld!");
+  std::cout << std::boolalpha << err.has_value() << std::endl;
   return 0;
 }
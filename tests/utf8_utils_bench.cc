@@ -0,0 +1,234 @@
+// Micro-benchmark with a throughput regression gate.
+//
+// Each engine is timed on every corpus next to the unoptimized equivalent
+// built from `tests/utf8_utils_reference.h`. References allocate no more per
+// call than their engine. The run fails when
+// - an engine is less than `--min-speedup=X` (default 1) times as fast as its
+//   reference. In Release, `Check`, `CheckAndHash`, `CheckAndCopy` and
+//   `ToLossy` lead their reference by 1.3 to 3x, so this fails when their fast
+//   path is lost. `HashFolded` and `EqualsIgnoreCase` lead by 5x or more,
+//   because their reference folds through a binary search, so for them this
+//   only catches a gross regression, or
+// - with `--baseline=FILE`, an engine drops more than `--tolerance=X`
+//   (default 0.1) below the MB/s recorded by `--write-baseline=FILE`. MB/s
+//   depend on the machine, so no baseline is checked in. Record one on the
+//   machine that runs the gate to guard every engine tightly.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tests/utf8_utils_reference.h"
+#include "utf8_utils/utf8_utils.h"
+
+namespace {
+
+struct Engine {
+  const char* name;
+  std::function<std::uint64_t(std::string_view)> run;
+  std::function<std::uint64_t(std::string_view)> reference;
+};
+
+struct Corpus {
+  const char* name;
+  std::string data;
+};
+
+// Keeps the results alive so the timed calls are not optimized away.
+volatile std::uint64_t sink;
+
+std::string Repeat(std::string_view piece, const std::size_t size) {
+  std::string str;
+  while (str.size() < size) {
+    str.append(piece);
+  }
+
+  return str;
+}
+
+struct Throughput {
+  double mbps{};
+  double reference_mbps{};
+};
+
+double MegabytesPerSecond(
+    const std::function<std::uint64_t(std::string_view)>& run,
+    std::string_view data) {
+  using Clock = std::chrono::steady_clock;
+  std::size_t bytes{};
+  const Clock::time_point start = Clock::now();
+  Clock::duration elapsed{};
+  do {
+    sink = sink + run(data);
+    bytes += data.size();
+    elapsed = Clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(20));
+
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  return static_cast<double>(bytes) / seconds / 1e6;
+}
+
+// Alternates between the engine and its reference and keeps the best round of
+// each, so that a noisy phase on a shared machine hits both sides alike.
+Throughput Measure(const Engine& engine, std::string_view data) {
+  Throughput best;
+  for (int repetition = 0; repetition < 10; ++repetition) {
+    best.mbps = std::max(best.mbps, MegabytesPerSecond(engine.run, data));
+    best.reference_mbps = std::max(
+        best.reference_mbps, MegabytesPerSecond(engine.reference, data));
+  }
+
+  return best;
+}
+
+// Folds `str` into a buffer reused across calls, so the references below pay
+// for the extra pass over the folded bytes but not for an allocation.
+std::string_view FoldReference(std::string_view str, std::string& folded) {
+  folded.clear();
+  utf8_utils::reference::AppendCaseFolded(folded, str);
+  return folded;
+}
+
+std::vector<Engine> Engines() {
+  return {
+      {"Check",
+       [](std::string_view str) {
+         return std::uint64_t{!utf8_utils::Check(str)};
+       },
+       [](std::string_view str) {
+         return std::uint64_t{!utf8_utils::reference::Check(str)};
+       }},
+      {"CheckAndHash",
+       [](std::string_view str) {
+         return utf8_utils::CheckAndHash(str).hash;
+       },
+       [](std::string_view str) {
+         return utf8_utils::reference::Check(str) ? 0 : utf8_utils::Hash(str);
+       }},
+      {"CheckAndCopy",
+       [](std::string_view str) {
+         static std::string out;
+         out.resize(str.size());
+         return std::uint64_t{!utf8_utils::CheckAndCopy(str, out.data())};
+       },
+       [](std::string_view str) {
+         static std::string out;
+         out.resize(str.size());
+         const bool valid = !utf8_utils::reference::Check(str);
+         std::memcpy(out.data(), str.data(), str.size());
+         return std::uint64_t{valid};
+       }},
+      {"ToLossy",
+       [](std::string_view str) {
+         return std::uint64_t{utf8_utils::ToLossy(str).size()};
+       },
+       [](std::string_view str) {
+         return std::uint64_t{utf8_utils::reference::ToLossy(str).size()};
+       }},
+      {"HashFolded",
+       [](std::string_view str) { return utf8_utils::HashFolded(str); },
+       [](std::string_view str) {
+         static std::string folded;
+         return utf8_utils::Hash(FoldReference(str, folded));
+       }},
+      {"EqualsIgnoreCase",
+       [](std::string_view str) {
+         return std::uint64_t{utf8_utils::EqualsIgnoreCase(str, str)};
+       },
+       [](std::string_view str) {
+         static std::string folded_a;
+         static std::string folded_b;
+         return std::uint64_t{FoldReference(str, folded_a) ==
+                              FoldReference(str, folded_b)};
+       }},
+  };
+}
+
+std::map<std::string, double> ReadBaseline(const char* path) {
+  std::map<std::string, double> baseline;
+  std::ifstream file(path);
+  std::string key;
+  double value{};
+  while (file >> key >> value) {
+    baseline[key] = value;
+  }
+
+  return baseline;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double min_speedup = 1;
+  double tolerance = 0.1;
+  const char* baseline_path = nullptr;
+  const char* write_baseline_path = nullptr;
+  for (int k = 1; k < argc; ++k) {
+    const std::string_view arg = argv[k];
+    if (arg.rfind("--min-speedup=", 0) == 0) {
+      min_speedup = std::strtod(argv[k] + 14, nullptr);
+    } else if (arg.rfind("--tolerance=", 0) == 0) {
+      tolerance = std::strtod(argv[k] + 12, nullptr);
+    } else if (arg.rfind("--baseline=", 0) == 0) {
+      baseline_path = argv[k] + 11;
+    } else if (arg.rfind("--write-baseline=", 0) == 0) {
+      write_baseline_path = argv[k] + 17;
+    } else {
+      std::fprintf(stderr, "unknown argument: %s\n", argv[k]);
+      return 2;
+    }
+  }
+
+  const std::vector<Corpus> corpora = {
+      {"ascii",
+       Repeat("GET /index.html HTTP/1.1\r\nContent-Type: text/plain\r\n",
+              1 << 16)},
+      {"mixed",
+       Repeat("The quick brown fox, der schnelle Fuchs, 빠른 갈색 여우 🦊. ",
+              1 << 16)},
+      {"large", Repeat("Größe, 한글, 😀 and mostly ASCII text around it. ",
+                       utf8_utils::kNonTemporalCopyThreshold * 4)},
+  };
+
+  const std::map<std::string, double> baseline =
+      baseline_path ? ReadBaseline(baseline_path)
+                    : std::map<std::string, double>{};
+  std::map<std::string, double> measured;
+  bool failed = false;
+  for (const Corpus& corpus : corpora) {
+    for (const Engine& engine : Engines()) {
+      const std::string key = std::string(corpus.name) + "/" + engine.name;
+      const Throughput throughput = Measure(engine, corpus.data);
+      const double mbps = throughput.mbps;
+      const double speedup = mbps / throughput.reference_mbps;
+      measured[key] = mbps;
+
+      bool ok = speedup >= min_speedup;
+      if (const auto it = baseline.find(key); it != baseline.end()) {
+        ok = ok && mbps >= it->second * (1 - tolerance);
+      }
+
+      failed = failed || !ok;
+      std::printf("%-24s %10.1f MB/s %8.2fx reference %s\n", key.c_str(), mbps,
+                  speedup, ok ? "" : "REGRESSED");
+    }
+  }
+
+  if (write_baseline_path) {
+    std::ofstream file(write_baseline_path);
+    for (const auto& [key, mbps] : measured) {
+      file << key << ' ' << mbps << '\n';
+    }
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+#ifndef UTF8_UTILS_TESTS_UTF8_UTILS_DIFFERENTIAL_H_
+#define UTF8_UTILS_TESTS_UTF8_UTILS_DIFFERENTIAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "tests/utf8_utils_reference.h"
+#include "utf8_utils/utf8_utils.h"
+
+// Runs every engine in `utf8_utils.h` on one input and compares it with
+// `tests/utf8_utils_reference.h`, down to the exact error position and length.
+// Shared by the exhaustive tests and the fuzz target.
+namespace utf8_utils::differential {
+
+// Bytes on either side of the lead and second byte ranges of Table 3-7. Every
+// engine branches on which of these ranges a byte falls in, so strings over
+// these bytes reach every branch.
+constexpr std::uint8_t kBoundaryBytes[] = {
+    0x00, 0x7f, 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc0, 0xc1, 0xc2,
+    0xdf, 0xe0, 0xe1, 0xec, 0xed, 0xee, 0xef, 0xf0, 0xf1, 0xf3, 0xf4,
+    0xf5, 0xff,
+};
+
+// Formats `str` as space separated hex bytes for failure messages.
+inline std::string Hex(std::string_view str) {
+  std::string hex;
+  for (const char c : str) {
+    char byte[4]{};
+    std::snprintf(byte, sizeof(byte), " %02x",
+                  static_cast<unsigned>(static_cast<std::uint8_t>(c)));
+    hex.append(byte);
+  }
+
+  return hex;
+}
+
+inline bool SameError(const std::optional<CheckError>& actual,
+                      const std::optional<CheckError>& expected) {
+  if (!actual || !expected) {
+    return !actual && !expected;
+  }
+
+  return actual->code == expected->code &&
+         actual->invalid_position == expected->invalid_position &&
+         actual->invalid_length == expected->invalid_length;
+}
+
+inline bool SameSequence(const DecodedSequence& actual,
+                         const DecodedSequence& expected) {
+  return actual.result == expected.result &&
+         actual.position == expected.position &&
+         actual.length == expected.length;
+}
+
+// Returns the name of the first engine that disagrees with the reference on
+// `str`, or `nullptr` if they all agree.
+inline const char* FindMismatch(std::string_view str) {
+  // `reference::Check` and `reference::ToLossy` both split the input with
+  // `DecodeAt` like `Split` does, so one split gives all expected results.
+  const std::vector<DecodedSequence> sequences = reference::Split(str);
+  std::optional<CheckError> expected;
+  std::string lossy;
+  for (const DecodedSequence& sequence : sequences) {
+    if (const ErrorCode* code = std::get_if<ErrorCode>(&sequence.result)) {
+      if (!expected) {
+        expected = CheckError{*code, sequence.position, sequence.length};
+      }
+
+      lossy.append("\xef\xbf\xbd");
+    } else {
+      lossy.append(str.substr(sequence.position, sequence.length));
+    }
+  }
+
+  const std::size_t valid_length =
+      expected ? expected->invalid_position : str.size();
+
+  if (!SameError(Check(str), expected)) {
+    return "Check";
+  }
+
+  const CheckAndHashResult hashed = CheckAndHash(str, 7);
+  if (!SameError(hashed.error, expected)) {
+    return "CheckAndHash";
+  }
+
+  if (hashed.hash != Hash(str.substr(0, valid_length), 7)) {
+    return "CheckAndHash hash";
+  }
+
+  // One spare byte in front so the streaming kernel sees a misaligned
+  // destination.
+  std::string out(str.size() + 1, '\0');
+  detail::ScanRecorder<NoStats> recorder{};
+  if (!SameError(detail::CheckAndCopyScalar(str.data(), str.size(),
+                                            out.data() + 1, recorder),
+                 expected)) {
+    return "CheckAndCopyScalar";
+  }
+
+  if (out.compare(1, valid_length, str, 0, valid_length) != 0) {
+    return "CheckAndCopyScalar output";
+  }
+
+#if defined(__SSE2__)
+  out.assign(str.size() + 1, '\0');
+  if (!SameError(detail::CheckAndCopyStream(str.data(), str.size(),
+                                            out.data() + 1, recorder),
+                 expected)) {
+    return "CheckAndCopyStream";
+  }
+
+  if (out.compare(1, valid_length, str, 0, valid_length) != 0) {
+    return "CheckAndCopyStream output";
+  }
+#endif
+
+  if (ToLossy(str) != lossy) {
+    return "ToLossy";
+  }
+
+  const std::optional<std::string> lossy_if_invalid = ToLossyIfInvalid(str);
+  if (expected ? lossy_if_invalid != lossy : lossy_if_invalid.has_value()) {
+    return "ToLossyIfInvalid";
+  }
+
+  auto it = sequences.rbegin();
+  for (const DecodedSequence& sequence : Reversed(str)) {
+    if (it == sequences.rend() || !SameSequence(sequence, *it++)) {
+      return "Reversed";
+    }
+  }
+
+  if (it != sequences.rend()) {
+    return "Reversed length";
+  }
+
+  for (const DecodedSequence& sequence : sequences) {
+    for (std::size_t pos = sequence.position;
+         pos < sequence.position + sequence.length; ++pos) {
+      if (AlignToBoundary(str, pos) != sequence.position) {
+        return "AlignToBoundary";
+      }
+    }
+  }
+
+  // `TryToUtf32` takes exactly one sequence, so it is compared whenever the
+  // lead byte spans the whole string.
+  if (!str.empty() &&
+      reference::SequenceLength(static_cast<std::uint8_t>(str[0])) ==
+          str.size() &&
+      TryToUtf32(str) != sequences.front().result) {
+    return "TryToUtf32";
+  }
+
+  return nullptr;
+}
+
+// Like `FindMismatch`, but puts `str` after 16 ASCII bytes, so that the word
+// and block fast paths run into its tail, and between 13 and 16 ASCII bytes,
+// so that it sits inside a word and a block that are not all ASCII.
+inline const char* FindMismatchAfterFastPaths(std::string_view str) {
+  std::string padded(16, 'a');
+  padded.append(str);
+  if (const char* mismatch = FindMismatch(padded)) {
+    return mismatch;
+  }
+
+  padded.assign(13, 'a');
+  padded.append(str);
+  padded.append(16, 'a');
+  return FindMismatch(padded);
+}
+
+}  // namespace utf8_utils::differential
+
+#endif  // UTF8_UTILS_TESTS_UTF8_UTILS_DIFFERENTIAL_H_
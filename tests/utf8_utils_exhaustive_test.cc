@@ -0,0 +1,86 @@
+// Compares every engine with `tests/utf8_utils_reference.h` on whole input
+// spaces. Takes about 10 s in Release and a few minutes unoptimized, so it is
+// a separate target that ctest only runs with UTF8_UTILS_EXHAUSTIVE_TESTS=ON.
+// `utf8_utils_test` runs a quick subset.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "tests/utf8_utils_differential.h"
+#include "tests/utf8_utils_reference.h"
+
+namespace utf8_utils {
+
+TEST(Exhaustive, AllStringsUpTo3Bytes) {
+  char bytes[3]{};
+  for (std::uint32_t n = 0; n < (1 << 24); ++n) {
+    bytes[0] = static_cast<char>(n);
+    bytes[1] = static_cast<char>(n >> 8);
+    bytes[2] = static_cast<char>(n >> 16);
+    for (std::size_t length = n < (1 << 8) ? 1 : n < (1 << 16) ? 2 : 3;
+         length <= 3; ++length) {
+      const std::string_view str(bytes, length);
+      ASSERT_STREQ(differential::FindMismatch(str), nullptr)
+          << differential::Hex(str);
+    }
+  }
+}
+
+// All 2^32 4-byte strings are too many, but every engine only branches on
+// which range of Table 3-7 a byte falls in. So the lead byte takes all 256
+// values and the other bytes take both ends of every range.
+TEST(Exhaustive, All4ByteStringsOverBoundaryBytes) {
+  char bytes[4]{};
+  for (std::uint32_t b0 = 0; b0 <= 0xff; ++b0) {
+    bytes[0] = static_cast<char>(b0);
+    for (const std::uint8_t b1 : differential::kBoundaryBytes) {
+      bytes[1] = static_cast<char>(b1);
+      for (const std::uint8_t b2 : differential::kBoundaryBytes) {
+        bytes[2] = static_cast<char>(b2);
+        for (const std::uint8_t b3 : differential::kBoundaryBytes) {
+          bytes[3] = static_cast<char>(b3);
+          const std::string_view str(bytes, 4);
+          ASSERT_STREQ(differential::FindMismatch(str), nullptr)
+              << differential::Hex(str);
+        }
+      }
+    }
+  }
+}
+
+TEST(Exhaustive, AllStringsUpTo4BoundaryBytesAfterFastPaths) {
+  using differential::kBoundaryBytes;
+  std::string str;
+  std::size_t count = 1;
+  for (std::size_t length = 1; length <= 4; ++length) {
+    count *= std::size(kBoundaryBytes);
+    for (std::size_t n = 0; n < count; ++n) {
+      str.clear();
+      for (std::size_t rest = n; str.size() < length;
+           rest /= std::size(kBoundaryBytes)) {
+        str.push_back(static_cast<char>(
+            kBoundaryBytes[rest % std::size(kBoundaryBytes)]));
+      }
+
+      ASSERT_STREQ(differential::FindMismatchAfterFastPaths(str), nullptr)
+          << differential::Hex(str);
+    }
+  }
+}
+
+TEST(Exhaustive, AllSupplementaryCodePoints) {
+  std::string str;
+  for (char32_t code_point = 0x10000; code_point <= 0x10ffff; ++code_point) {
+    str.clear();
+    reference::AppendUtf8(str, code_point);
+    ASSERT_STREQ(differential::FindMismatch(str), nullptr)
+        << differential::Hex(str);
+  }
+}
+
+}  // namespace utf8_utils
@@ -0,0 +1,161 @@
+// Differential fuzz target: every engine in `utf8_utils.h` must agree with
+// `tests/utf8_utils_reference.h`, down to the exact error position and length.
+//
+// Built with `-fsanitize=fuzzer` this is a libFuzzer target. Otherwise
+// `UTF8_UTILS_FUZZ_STANDALONE` adds a `main` that replays the files given as
+// arguments and then runs `--iterations=N` generated inputs (`--seed=N`).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "tests/utf8_utils_differential.h"
+#include "tests/utf8_utils_reference.h"
+#include "utf8_utils/utf8_utils.h"
+
+namespace {
+
+void Expect(const bool condition, const char* what, std::string_view input) {
+  if (condition) {
+    return;
+  }
+
+  std::fprintf(stderr, "mismatch in %s for input:%s\n", what,
+               utf8_utils::differential::Hex(input).c_str());
+  std::abort();
+}
+
+void FuzzEngines(std::string_view str) {
+  const char* mismatch = utf8_utils::differential::FindMismatch(str);
+  Expect(mismatch == nullptr, mismatch, str);
+  Expect(utf8_utils::differential::SameError(
+             utf8_utils::Check<utf8_utils::ThreadLocalStats>(str),
+             utf8_utils::reference::Check(str)),
+         "Check<ThreadLocalStats>", str);
+}
+
+void FuzzCaseFold(std::string_view a, std::string_view b) {
+  const std::string folded_a = utf8_utils::reference::CaseFold(a);
+  const std::string folded_b = utf8_utils::reference::CaseFold(b);
+
+  std::string out(utf8_utils::CaseFoldBufferSize(a.size()), '\0');
+  out.resize(utf8_utils::CaseFold(a, out.data()));
+  Expect(out == folded_a, "CaseFold", a);
+  Expect(utf8_utils::HashFolded(a) == utf8_utils::Hash(folded_a),
+         "HashFolded", a);
+  Expect(utf8_utils::EqualsIgnoreCase(a, folded_a), "EqualsIgnoreCase folded",
+         a);
+  Expect(utf8_utils::EqualsIgnoreCase(a, b) == (folded_a == folded_b),
+         "EqualsIgnoreCase", a);
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      const std::size_t size) {
+  const std::string_view str(reinterpret_cast<const char*>(data), size);
+  FuzzEngines(str);
+
+  const std::size_t split = size == 0 ? 0 : data[0] % size;
+  FuzzCaseFold(str.substr(0, split), str.substr(split));
+  return 0;
+}
+
+#if defined(UTF8_UTILS_FUZZ_STANDALONE)
+
+namespace {
+
+// Code points around the edges the engines and the case folding table care
+// about, so that generated inputs are mostly valid with some corruption.
+constexpr char32_t kInterestingCodePoints[] = {
+    0x0041, 0x005a, 0x0061, 0x007a, 0x007f, 0x0080, 0x00b5,
+    0x00df, 0x0130, 0x0178, 0x023a, 0x03a3, 0x03c2, 0x07ff,
+    0x0800, 0x1e9e, 0x212a, 0xd7ff, 0xe000, 0xffff, 0x10000,
+    0x10400, 0x1e921, 0x10ffff,
+};
+
+std::string Generate(std::mt19937_64& rng) {
+  using utf8_utils::differential::kBoundaryBytes;
+  std::string str;
+  const std::size_t pieces = rng() % 32;
+  for (std::size_t k = 0; k < pieces; ++k) {
+    switch (rng() % 6) {
+      case 0:
+        // ASCII runs long enough for the word and block fast paths.
+        str.append(rng() % 40, static_cast<char>('A' + rng() % 58));
+        break;
+      case 1: {
+        const std::size_t index = rng() % std::size(kInterestingCodePoints);
+        utf8_utils::reference::AppendUtf8(str, kInterestingCodePoints[index]);
+        break;
+      }
+      case 2: {
+        char32_t code_point = rng() % 0x110000;
+        if (0xd800 <= code_point && code_point <= 0xdfff) {
+          code_point = 0xfffd;
+        }
+
+        utf8_utils::reference::AppendUtf8(str, code_point);
+        break;
+      }
+      case 3:
+        str.push_back(static_cast<char>(rng()));
+        break;
+      case 4:
+        for (std::size_t length = 1 + rng() % 4; length > 0; --length) {
+          str.push_back(static_cast<char>(
+              kBoundaryBytes[rng() % std::size(kBoundaryBytes)]));
+        }
+
+        break;
+      default:
+        if (!str.empty()) {
+          str.resize(str.size() - 1);
+        }
+
+        break;
+    }
+  }
+
+  return str;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::uint64_t iterations = 100000;
+  std::uint64_t seed = std::random_device{}();
+  for (int k = 1; k < argc; ++k) {
+    const std::string_view arg = argv[k];
+    if (arg.rfind("--iterations=", 0) == 0) {
+      iterations = std::strtoull(argv[k] + 13, nullptr, 10);
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = std::strtoull(argv[k] + 7, nullptr, 10);
+    } else {
+      std::ifstream file(argv[k], std::ios::binary);
+      const std::string data{std::istreambuf_iterator<char>(file), {}};
+      LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(data.data()),
+                             data.size());
+    }
+  }
+
+  std::printf("seed: %llu\n", static_cast<unsigned long long>(seed));
+  std::mt19937_64 rng{seed};
+  for (std::uint64_t k = 0; k < iterations; ++k) {
+    const std::string data = Generate(rng);
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(data.data()),
+                           data.size());
+  }
+
+  std::printf("passed %llu generated inputs\n",
+              static_cast<unsigned long long>(iterations));
+  return 0;
+}
+
+#endif  // defined(UTF8_UTILS_FUZZ_STANDALONE)
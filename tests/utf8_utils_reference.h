@@ -0,0 +1,223 @@
+#ifndef UTF8_UTILS_TESTS_UTF8_UTILS_REFERENCE_H_
+#define UTF8_UTILS_TESTS_UTF8_UTILS_REFERENCE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "tests/utf8_utils_case_folding.h"
+#include "utf8_utils/utf8_utils.h"
+
+// A deliberately simple reimplementation of how `Check` splits its input,
+// written from the well-formed byte sequence table of the Unicode standard
+// (Table 3-7), with case folding looked up in pairs generated from
+// CaseFolding.txt. Optimized engines are tested against it, so it must not
+// share code with `utf8_utils.h` beyond the public types.
+namespace utf8_utils::reference {
+
+struct Bounds {
+  std::uint8_t lo{};
+  std::uint8_t hi{};
+};
+
+// Returns 0 for bytes that cannot start a sequence.
+inline std::size_t SequenceLength(const std::uint8_t b0) {
+  if (b0 <= 0x7f) {
+    return 1;
+  }
+
+  if (0xc2 <= b0 && b0 <= 0xdf) {
+    return 2;
+  }
+
+  if (0xe0 <= b0 && b0 <= 0xef) {
+    return 3;
+  }
+
+  if (0xf0 <= b0 && b0 <= 0xf4) {
+    return 4;
+  }
+
+  return 0;
+}
+
+inline Bounds SecondByteBounds(const std::uint8_t b0) {
+  switch (b0) {
+    case 0xe0:
+      return {0xa0, 0xbf};
+    case 0xed:
+      return {0x80, 0x9f};
+    case 0xf0:
+      return {0x90, 0xbf};
+    case 0xf4:
+      return {0x80, 0x8f};
+    default:
+      return {0x80, 0xbf};
+  }
+}
+
+inline ErrorCode SecondByteError(const std::uint8_t b0) {
+  switch (b0) {
+    case 0xe0:
+      return ErrorCode::kOverlongOf3Bytes;
+    case 0xed:
+      return ErrorCode::kUtf16Surrogate;
+    case 0xf0:
+      return ErrorCode::kOverlongOf4Bytes;
+    default:
+      return ErrorCode::kOutOfUnicodeRange;
+  }
+}
+
+inline ErrorCode IncompleteError(const std::size_t length) {
+  switch (length) {
+    case 2:
+      return ErrorCode::kIncomplete2Bytes;
+    case 3:
+      return ErrorCode::kIncomplete3Bytes;
+    default:
+      return ErrorCode::kIncomplete4Bytes;
+  }
+}
+
+inline ErrorCode NotContinuationError(const std::size_t k) {
+  switch (k) {
+    case 1:
+      return ErrorCode::kNotSecondIsContinuation;
+    case 2:
+      return ErrorCode::kNotThirdIsContinuation;
+    default:
+      return ErrorCode::kNotFourthIsContinuation;
+  }
+}
+
+// Decodes the sequence at `position`.
+inline DecodedSequence DecodeAt(std::string_view str,
+                                const std::size_t position) {
+  const auto byte = [&](std::size_t k) {
+    return static_cast<std::uint8_t>(str[position + k]);
+  };
+
+  const std::uint8_t b0 = byte(0);
+  const std::size_t length = SequenceLength(b0);
+  if (length == 0) {
+    return {ErrorCode::kDisallowedFirstByte, position, 1};
+  }
+
+  char32_t code_point = length == 1 ? b0 : b0 & (0xff >> (length + 1));
+  for (std::size_t k = 1; k < length; ++k) {
+    if (position + k >= str.size()) {
+      return {IncompleteError(length), position, k};
+    }
+
+    const std::uint8_t b = byte(k);
+    if (b < 0x80 || 0xbf < b) {
+      return {NotContinuationError(k), position, k};
+    }
+
+    if (k == 1) {
+      const Bounds bounds = SecondByteBounds(b0);
+      if (b < bounds.lo || bounds.hi < b) {
+        return {SecondByteError(b0), position, 2};
+      }
+    }
+
+    code_point = code_point << 6 | (b & 0x3f);
+  }
+
+  return {code_point, position, length};
+}
+
+inline std::vector<DecodedSequence> Split(std::string_view str) {
+  std::vector<DecodedSequence> sequences;
+  for (std::size_t i = 0; i < str.size(); i += sequences.back().length) {
+    sequences.push_back(DecodeAt(str, i));
+  }
+
+  return sequences;
+}
+
+inline std::optional<CheckError> Check(std::string_view str) {
+  for (std::size_t i = 0; i < str.size();) {
+    const DecodedSequence sequence = DecodeAt(str, i);
+    if (const ErrorCode* code = std::get_if<ErrorCode>(&sequence.result)) {
+      return CheckError{*code, sequence.position, sequence.length};
+    }
+
+    i += sequence.length;
+  }
+
+  return std::nullopt;
+}
+
+// Appends each valid run whole, like `utf8_utils::ToLossy`, so that the two
+// only differ in how they find the errors.
+inline std::string ToLossy(std::string_view str) {
+  std::string result;
+  while (const std::optional<CheckError> err = Check(str)) {
+    result.append(str.substr(0, err->invalid_position));
+    result.append("\xef\xbf\xbd");
+    str.remove_prefix(err->invalid_position + err->invalid_length);
+  }
+
+  result.append(str);
+  return result;
+}
+
+inline void AppendUtf8(std::string& out, const char32_t code_point) {
+  if (code_point < 0x80) {
+    out.push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out.push_back(static_cast<char>(0xc0 | code_point >> 6));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    out.push_back(static_cast<char>(0xe0 | code_point >> 12));
+    out.push_back(static_cast<char>(0x80 | (code_point >> 6 & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    out.push_back(static_cast<char>(0xf0 | code_point >> 18));
+    out.push_back(static_cast<char>(0x80 | (code_point >> 12 & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (code_point >> 6 & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+// Looks `code_point` up in the pairs generated from CaseFolding.txt.
+inline char32_t CaseFold(const char32_t code_point) {
+  const CaseFoldPair* const end = std::end(kCaseFoldPairs);
+  const CaseFoldPair* const it = std::lower_bound(
+      std::begin(kCaseFoldPairs), end, code_point,
+      [](const CaseFoldPair& pair, const char32_t value) {
+        return pair.code_point < value;
+      });
+  return it != end && it->code_point == code_point ? it->folded : code_point;
+}
+
+// Appends `str` to `out`, folding every code point with the per code point
+// `CaseFold` and keeping the bytes of invalid sequences as they are.
+inline void AppendCaseFolded(std::string& out, std::string_view str) {
+  for (std::size_t i = 0; i < str.size();) {
+    const DecodedSequence sequence = DecodeAt(str, i);
+    if (const char32_t* code_point = std::get_if<char32_t>(&sequence.result)) {
+      AppendUtf8(out, CaseFold(*code_point));
+    } else {
+      out.append(str.substr(sequence.position, sequence.length));
+    }
+
+    i += sequence.length;
+  }
+}
+
+inline std::string CaseFold(std::string_view str) {
+  std::string result;
+  AppendCaseFolded(result, str);
+  return result;
+}
+
+}  // namespace utf8_utils::reference
+
+#endif  // UTF8_UTILS_TESTS_UTF8_UTILS_REFERENCE_H_
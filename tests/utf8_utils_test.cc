@@ -1,191 +1,437 @@
-#include "utf8_scanner/utf8_scanner.h"
+#include "utf8_utils/utf8_utils.h"
 
 #include <gtest/gtest.h>
 
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "tests/utf8_utils_differential.h"
+#include "tests/utf8_utils_reference.h"
 
-namespace utf8_scanner {
+namespace utf8_utils {
 
 TEST(all_tests, Basic) {
   EXPECT_TRUE(true);
   // std::istringstream stream(std::string_view("Hello, world!"));
 }
 
-// TEST(IsAscii, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (0x00 <= b && b <= 0x7f) {
-//       EXPECT_TRUE(IsAscii(b));
-//     } else {
-//       EXPECT_FALSE(IsAscii(b));
-//     }
-//   }
-// }
-
-// TEST(IsStartOf2Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (0xc2 <= b && b <= 0xdf) {
-//       EXPECT_TRUE(IsStartOf2Byte(b));
-//     } else {
-//       EXPECT_FALSE(IsStartOf2Byte(b));
-//     }
-//   }
-// }
-
-// TEST(IsStartOf3Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (0xe0 <= b && b <= 0xef) {
-//       EXPECT_TRUE(IsStartOf3Byte(b));
-//     } else {
-//       EXPECT_FALSE(IsStartOf3Byte(b));
-//     }
-//   }
-// }
-
-// TEST(IsStartOf4Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (0xf0 <= b && b <= 0xf4) {
-//       EXPECT_TRUE(IsStartOf4Byte(b));
-//     } else {
-//       EXPECT_FALSE(IsStartOf4Byte(b));
-//     }
-//   }
-// }
-
-// TEST(IsContinuation, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (0x80 <= b && b <= 0xbf) {
-//       EXPECT_TRUE(IsContinuation(b));
-//     } else {
-//       EXPECT_FALSE(IsContinuation(b));
-//     }
-//   }
-// }
-
-// TEST(IsOverlong3Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       if (b0 == 0xe0 && b1 < 0xa0) {
-//         EXPECT_TRUE(IsOverlong3Byte(b0, b1));
-//       } else {
-//         EXPECT_FALSE(IsOverlong3Byte(b0, b1));
-//       }
-//     }
-//   }
-// }
-
-// TEST(IsUtf16Surrogate, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       if (b0 == 0xed && 0xa0 <= b1) {
-//         EXPECT_TRUE(IsUtf16Surrogate(b0, b1));
-//       } else {
-//         EXPECT_FALSE(IsUtf16Surrogate(b0, b1));
-//       }
-//     }
-//   }
-// }
-
-// TEST(IsOverlong4Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       if (b0 == 0xf0 && b1 < 0x90) {
-//         EXPECT_TRUE(IsOverlong4Byte(b0, b1));
-//       } else {
-//         EXPECT_FALSE(IsOverlong4Byte(b0, b1));
-//       }
-//     }
-//   }
-// }
-
-// TEST(IsOutOfUnicodeRange, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       if (b0 == 0xf4 && 0x90 <= b1) {
-//         EXPECT_TRUE(IsOutOfUnicodeRange(b0, b1));
-//       } else {
-//         EXPECT_FALSE(IsOutOfUnicodeRange(b0, b1));
-//       }
-//     }
-//   }
-// }
-
-// TEST(CodePointFromAscii, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b = static_cast<Byte>(i);
-//     if (IsAscii(b)) {
-//       EXPECT_EQ(CodePointFromAscii(b), b);
-//     }
-//   }
-// }
-
-// TEST(CodePointFrom2Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       if (IsStartOf2Byte(b0) && IsContinuation(b1)) {
-//         EXPECT_EQ(CodePointFrom2Byte(b0, b1),
-//                   (b0 & 0b00011111) << 6 | (b1 & 0b00111111));
-//       }
-//     }
-//   }
-// }
-
-// TEST(CodePointFrom3Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       for (int k = 0x00; k <= 0xff; ++k) {
-//         const Byte b2 = static_cast<Byte>(k);
-//         if (IsStartOf3Byte(b0) && !IsOverlong3Byte(b0, b1) &&
-//             !IsUtf16Surrogate(b0, b1) && IsContinuation(b1) &&
-//             IsContinuation(b2)) {
-//           EXPECT_EQ(CodePointFrom3Byte(b0, b1, b2), (b0 & 0b00001111) << 12 |
-//                                                         (b1 & 0b00111111) <<
-//                                                         6 | (b2 &
-//                                                         0b00111111));
-//         }
-//       }
-//     }
-//   }
-// }
-
-// TEST(CodePointFrom4Byte, Basic) {
-//   for (int i = 0x00; i <= 0xff; ++i) {
-//     const Byte b0 = static_cast<Byte>(i);
-//     for (int j = 0x00; j <= 0xff; ++j) {
-//       const Byte b1 = static_cast<Byte>(j);
-//       for (int k = 0x00; k <= 0xff; ++k) {
-//         const Byte b2 = static_cast<Byte>(k);
-//         for (int l = 0x00; l <= 0xff; ++l) {
-//           const Byte b3 = static_cast<Byte>(l);
-//           if (IsStartOf4Byte(b0) && !IsOverlong4Byte(b0, b1) &&
-//               !IsOutOfUnicodeRange(b0, b1) && IsContinuation(b1) &&
-//               IsContinuation(b2) && IsContinuation(b3)) {
-//             EXPECT_EQ(CodePointFrom4Byte(b0, b1, b2, b3),
-//                       (b0 & 0b00000111) << 18 | (b1 & 0b00111111) << 12 |
-//                           (b2 & 0b00111111) << 6 | (b3 & 0b00111111));
-//           }
-//         }
-//       }
-//     }
-//   }
-// }
-
-}  // namespace utf8_scanner
+TEST(CaseFold, CodePoint) {
+  EXPECT_EQ(CaseFold(U'A'), U'a');
+  EXPECT_EQ(CaseFold(U'z'), U'z');
+  EXPECT_EQ(CaseFold(U'@'), U'@');
+  EXPECT_EQ(CaseFold(U'É'), U'é');
+  EXPECT_EQ(CaseFold(U'Ā'), U'ā');
+  EXPECT_EQ(CaseFold(U'ā'), U'ā');
+  EXPECT_EQ(CaseFold(U'Σ'), U'σ');
+  EXPECT_EQ(CaseFold(U'ς'), U'σ');
+  EXPECT_EQ(CaseFold(U'Ⱥ'), U'ⱥ');
+  EXPECT_EQ(CaseFold(U'ẞ'), U'ß');
+  EXPECT_EQ(CaseFold(U'K'), U'k');
+  EXPECT_EQ(CaseFold(U'\U00010400'), U'\U00010428');
+  EXPECT_EQ(CaseFold(U'\U0001e921'), U'\U0001e943');
+  EXPECT_EQ(CaseFold(U'\U0001f600'), U'\U0001f600');
+}
+
+// `kCaseFoldRanges` against the pairs generated from CaseFolding.txt, over
+// every code point including those that do not fold.
+TEST(CaseFold, MatchesCaseFoldingTxt) {
+  for (char32_t code_point = 0; code_point <= 0x10ffff; ++code_point) {
+    ASSERT_EQ(CaseFold(code_point), reference::CaseFold(code_point))
+        << "U+" << std::hex << static_cast<std::uint32_t>(code_point);
+  }
+}
+
+TEST(CaseFold, Buffer) {
+  const std::string_view str = "HELLO, WORLD! ȺKẞ\xff";
+  std::string out(CaseFoldBufferSize(str.size()), '\0');
+  out.resize(CaseFold(str, out.data()));
+  EXPECT_EQ(out, "hello, world! ⱥkß\xff");
+}
+
+TEST(EqualsIgnoreCase, Basic) {
+  EXPECT_TRUE(EqualsIgnoreCase("", ""));
+  EXPECT_TRUE(EqualsIgnoreCase("Content-Type", "content-type"));
+  EXPECT_TRUE(
+      EqualsIgnoreCase("CONTENT-TYPE: TEXT/PLAIN", "content-type: text/plain"));
+  EXPECT_FALSE(EqualsIgnoreCase("content-type", "content-typ"));
+  EXPECT_FALSE(EqualsIgnoreCase("content-type", "content_type"));
+  EXPECT_TRUE(EqualsIgnoreCase("ΟΔΥΣΣΕΥΣ", "οδυσσευς"));
+  EXPECT_TRUE(EqualsIgnoreCase("Kelvin scale", "kELVIN SCALE"));
+  EXPECT_FALSE(EqualsIgnoreCase("STRASSE", "straße"));
+  EXPECT_TRUE(EqualsIgnoreCase("ab\xff" "cd", "AB\xff" "CD"));
+  EXPECT_FALSE(EqualsIgnoreCase("ab\xc3", "ab\xc3\xa9"));
+}
+
+TEST(HashFolded, Basic) {
+  EXPECT_EQ(HashFolded("Content-Type: Text/Plain"),
+            HashFolded("content-type: text/plain"));
+  EXPECT_EQ(HashFolded("KELVIN SCALE, KELVIN"),
+            HashFolded("kelvin scale, kelvin"));
+  EXPECT_NE(HashFolded("content-type"), HashFolded("content-typf"));
+  EXPECT_NE(HashFolded("a"), HashFolded(std::string_view("a\0", 2)));
+  EXPECT_NE(HashFolded("a", 1), HashFolded("a", 2));
+
+  const std::string_view str = "ΟΔΥΣΣΕΥ STRASSE";
+  std::string folded(CaseFoldBufferSize(str.size()), '\0');
+  folded.resize(CaseFold(str, folded.data()));
+  EXPECT_EQ(HashFolded(str), HashFolded(folded));
+}
+
+TEST(Check, MultiBytesAfterAscii) {
+  EXPECT_FALSE(Check("aé"));
+  EXPECT_FALSE(Check("abc한글😀"));
+
+  const auto err = Check("abc\xed\xa0\x80");
+  ASSERT_TRUE(err);
+  EXPECT_EQ(err->code, ErrorCode::kUtf16Surrogate);
+  EXPECT_EQ(err->invalid_position, 3);
+  EXPECT_EQ(err->invalid_length, 2);
+}
+
+TEST(CheckAndHash, Basic) {
+  for (const std::string_view str :
+       {"", "a", "hello, world!", "héllo, wörld! 한글 😀 and some ascii tail",
+        "0123456789abcdef0123456789abcdef"}) {
+    const CheckAndHashResult result = CheckAndHash(str, 42);
+    EXPECT_FALSE(result.error);
+    EXPECT_EQ(result.hash, Hash(str, 42));
+  }
+
+  const std::string_view str = "hello, world!\xe0\x80\x80 tail";
+  const CheckAndHashResult result = CheckAndHash(str, 42);
+  ASSERT_TRUE(result.error);
+  EXPECT_EQ(result.error->code, ErrorCode::kOverlongOf3Bytes);
+  EXPECT_EQ(result.error->invalid_position, 13);
+  EXPECT_EQ(result.error->invalid_length, 2);
+  EXPECT_EQ(result.hash, Hash(str.substr(0, 13), 42));
+
+  EXPECT_EQ(CheckAndHash(nullptr, 0).error->code, ErrorCode::kNullStringPtr);
+}
+
+TEST(CheckAndCopy, Basic) {
+  const std::string_view str = "héllo, wörld! 한글 😀 and some ascii tail";
+  std::string out(str.size(), '\0');
+  EXPECT_FALSE(CheckAndCopy(str, out.data()));
+  EXPECT_EQ(out, str);
+
+  const std::string_view invalid = "héllo\xc3(";
+  std::string invalid_out(invalid.size(), '\0');
+  const auto err = CheckAndCopy(invalid, invalid_out.data());
+  ASSERT_TRUE(err);
+  EXPECT_EQ(err->code, ErrorCode::kNotSecondIsContinuation);
+  EXPECT_EQ(err->invalid_position, 6);
+  EXPECT_EQ(invalid_out.substr(0, 6), invalid.substr(0, 6));
+}
+
+TEST(CheckAndCopy, Large) {
+  std::string str;
+  while (str.size() < kNonTemporalCopyThreshold * 2) {
+    str.append("The quick brown fox jumps over the lazy dog. ");
+    str.append("Größe 한글 😀 ");
+  }
+
+  std::string out(str.size() + 1, '\0');
+  EXPECT_FALSE(CheckAndCopy(str, out.data() + 1));
+  EXPECT_EQ(std::string_view(out).substr(1), str);
+
+  const std::size_t invalid_position = str.size() - 100;
+  str[invalid_position] = '\xff';
+  std::string invalid_out(str.size(), '\0');
+  const auto err = CheckAndCopy(str, invalid_out.data());
+  ASSERT_TRUE(err);
+  EXPECT_EQ(err->code, Check(str)->code);
+  EXPECT_EQ(err->invalid_position, Check(str)->invalid_position);
+  EXPECT_EQ(invalid_out.substr(0, err->invalid_position),
+            str.substr(0, err->invalid_position));
+}
+
+TEST(ToLossyIfInvalid, Basic) {
+  EXPECT_FALSE(ToLossyIfInvalid("héllo"));
+  EXPECT_EQ(ToLossyIfInvalid("h\xffllo"), "h�llo");
+}
+
+TEST(Stats, NoStatsIsConstexpr) {
+  static_assert(!Check("héllo"));
+  static_assert(Check("\xff")->code == ErrorCode::kDisallowedFirstByte);
+}
+
+TEST(Stats, ThreadLocalStats) {
+  ResetStats();
+  EXPECT_FALSE(Check<ThreadLocalStats>("aé한😀"));
+  EXPECT_TRUE(Check<ThreadLocalStats>("ab\xed\xa0\x80"));
+  EXPECT_FALSE(CheckAndHash<ThreadLocalStats>("0123456789").error);
+  EXPECT_TRUE(Check<ThreadLocalStats>(nullptr, 0));
+
+  std::thread thread([] {
+    EXPECT_EQ(ToLossy<ThreadLocalStats>("a\xff" "b\xff" "c"), "a�b�c");
+  });
+  thread.join();
+
+  const Stats stats = CollectStats();
+  EXPECT_EQ(stats.calls, 5);
+  EXPECT_EQ(stats.bytes_scanned, 10 + 4 + 10 + 5);
+  EXPECT_EQ(stats.fast_path_bytes, 1 + 8);
+  EXPECT_EQ(stats.sequences[0], 1 + 2 + 10 + 3);
+  EXPECT_EQ(stats.sequences[1], 1);
+  EXPECT_EQ(stats.sequences[2], 1);
+  EXPECT_EQ(stats.sequences[3], 1);
+  EXPECT_EQ(stats.errors[static_cast<std::size_t>(ErrorCode::kUtf16Surrogate)],
+            1);
+  EXPECT_EQ(
+      stats.errors[static_cast<std::size_t>(ErrorCode::kDisallowedFirstByte)],
+      2);
+  EXPECT_EQ(stats.errors[static_cast<std::size_t>(ErrorCode::kNullStringPtr)],
+            1);
+  // Inputs shorter than a word never reach the word loop, and the null input
+  // takes no path.
+  EXPECT_EQ(
+      stats.dispatch_paths[static_cast<std::size_t>(DispatchPath::kScalar)], 2);
+  EXPECT_EQ(stats.dispatch_paths[static_cast<std::size_t>(DispatchPath::kSwar)],
+            2);
+
+  ResetStats();
+  EXPECT_EQ(CollectStats().calls, 0);
+}
+
+struct CountingStats {
+  static constexpr bool kEnabled = true;
+  static inline Stats recorded;
+
+  static void Record(const Stats& stats) noexcept {
+    VisitStats(stats, [](std::string_view name, std::string_view label,
+                         std::uint64_t value) {
+      if (name == "errors" && label == "incomplete_3_bytes") {
+        recorded.errors[static_cast<std::size_t>(
+            ErrorCode::kIncomplete3Bytes)] += value;
+      }
+
+      if (name == "bytes_scanned") {
+        recorded.bytes_scanned += value;
+      }
+    });
+  }
+};
+
+TEST(Stats, CustomPolicy) {
+  std::string out(4, '\0');
+  EXPECT_TRUE(CheckAndCopy<CountingStats>("ab\xea\xb0", out.data()));
+  EXPECT_EQ(CountingStats::recorded.errors[static_cast<std::size_t>(
+                ErrorCode::kIncomplete3Bytes)],
+            1);
+  EXPECT_EQ(CountingStats::recorded.bytes_scanned, 4);
+}
+
+TEST(Check, NonContinuationAfterSpecialLeadBytes) {
+  for (const std::string_view str : {"\xe0" "A", "\xed\xed", "\xf0" "A",
+                                     "\xf4\xf4"}) {
+    const auto err = Check(str);
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err->code, ErrorCode::kNotSecondIsContinuation);
+    EXPECT_EQ(err->invalid_position, 0);
+    EXPECT_EQ(err->invalid_length, 1);
+  }
+}
+
+std::vector<DecodedSequence> ForwardSequences(std::string_view str) {
+  std::vector<DecodedSequence> sequences;
+  std::size_t i{};
+  while (i < str.size()) {
+    const std::size_t start = i;
+    if (auto err = detail::CheckSequence(str.data(), str.size(), i); err) {
+      EXPECT_EQ(err->invalid_position, start);
+      EXPECT_EQ(err->invalid_length, i - start);
+      sequences.push_back({err->code, start, i - start});
+    } else {
+      sequences.push_back(
+          {MustToUtf32(str.substr(start, i - start)), start, i - start});
+    }
+  }
+
+  return sequences;
+}
+
+void ExpectSameSequence(const DecodedSequence& lhs,
+                        const DecodedSequence& rhs) {
+  EXPECT_EQ(lhs.result, rhs.result);
+  EXPECT_EQ(lhs.position, rhs.position);
+  EXPECT_EQ(lhs.length, rhs.length);
+}
+
+TEST(PrevCodePoint, Basic) {
+  const std::string_view str = "a한😀";
+  EXPECT_FALSE(PrevCodePoint(str, 0));
+  ExpectSameSequence(*PrevCodePoint(str, 8), {U'😀', 4, 4});
+  ExpectSameSequence(*PrevCodePoint(str, 4), {U'한', 1, 3});
+  ExpectSameSequence(*PrevCodePoint(str, 1), {U'a', 0, 1});
+  ExpectSameSequence(*PrevCodePoint(str, 6),
+                     {ErrorCode::kIncomplete4Bytes, 4, 2});
+  ExpectSameSequence(*PrevCodePoint("\x80\x80\x80\x80\x80", 5),
+                     {ErrorCode::kDisallowedFirstByte, 4, 1});
+}
+
+TEST(AlignToBoundary, Basic) {
+  const std::string_view str = "a한😀";
+  EXPECT_EQ(AlignToBoundary(str, 0), 0);
+  EXPECT_EQ(AlignToBoundary(str, 2), 1);
+  EXPECT_EQ(AlignToBoundary(str, 3), 1);
+  EXPECT_EQ(AlignToBoundary(str, 7), 4);
+  EXPECT_EQ(AlignToBoundary(str, 8), 8);
+  EXPECT_EQ(AlignToBoundary(str, 100), 8);
+  EXPECT_EQ(AlignToBoundary("\xe0\x80\x80", 2), 2);
+}
+
+TEST(Reversed, MatchesForwardSplit) {
+  constexpr std::array<char, 13> kBytes = {
+      'A',    '\x80', '\x9f', '\xa0', '\xbf', '\xc0', '\xc2',
+      '\xe0', '\xed', '\xef', '\xf0', '\xf4', '\xff'};
+  std::string str;
+  for (std::size_t len = 0; len <= 5; ++len) {
+    std::size_t count = 1;
+    for (std::size_t k = 0; k < len; ++k) {
+      count *= kBytes.size();
+    }
+
+    for (std::size_t n = 0; n < count; ++n) {
+      str.clear();
+      for (std::size_t m = n, k = 0; k < len; ++k, m /= kBytes.size()) {
+        str.push_back(kBytes[m % kBytes.size()]);
+      }
+
+      const std::vector<DecodedSequence> forward = ForwardSequences(str);
+      std::vector<DecodedSequence> backward;
+      for (const DecodedSequence& sequence : Reversed(str)) {
+        backward.push_back(sequence);
+      }
+
+      ASSERT_EQ(forward.size(), backward.size());
+      for (std::size_t k = 0; k < forward.size(); ++k) {
+        ExpectSameSequence(forward[k], backward[backward.size() - 1 - k]);
+        for (std::size_t pos = forward[k].position;
+             pos < forward[k].position + forward[k].length; ++pos) {
+          ASSERT_EQ(AlignToBoundary(str, pos), forward[k].position);
+        }
+      }
+    }
+  }
+}
+
+TEST(TryToUtf32, SameErrorPrecedenceAsCheck) {
+  EXPECT_EQ(TryToUtf32("\xe0" "A\x80"),
+            TryResult{ErrorCode::kNotSecondIsContinuation});
+  EXPECT_EQ(Check("\xe0" "A\x80")->code, ErrorCode::kNotSecondIsContinuation);
+  EXPECT_EQ(TryToUtf32("\xed" "A\x80"),
+            TryResult{ErrorCode::kNotSecondIsContinuation});
+  EXPECT_EQ(TryToUtf32("\xf0" "A\x80\x80"),
+            TryResult{ErrorCode::kNotSecondIsContinuation});
+  EXPECT_EQ(TryToUtf32("\xf4" "A\x80\x80"),
+            TryResult{ErrorCode::kNotSecondIsContinuation});
+  EXPECT_EQ(TryToUtf32("\xe0\x80\x80"),
+            TryResult{ErrorCode::kOverlongOf3Bytes});
+  EXPECT_EQ(TryToUtf32("\xf4\x90\x80\x80"),
+            TryResult{ErrorCode::kOutOfUnicodeRange});
+}
+
+TEST(Utf8BytesLength, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b = static_cast<std::uint8_t>(i);
+    if (b <= 0x7f) {
+      EXPECT_EQ(Utf8BytesLength(b), 1);
+    } else if (0xc2 <= b && b <= 0xdf) {
+      EXPECT_EQ(Utf8BytesLength(b), 2);
+    } else if (0xe0 <= b && b <= 0xef) {
+      EXPECT_EQ(Utf8BytesLength(b), 3);
+    } else if (0xf0 <= b && b <= 0xf4) {
+      EXPECT_EQ(Utf8BytesLength(b), 4);
+    } else {
+      EXPECT_EQ(Utf8BytesLength(b), 0);
+    }
+  }
+}
+
+TEST(IsContinuation, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b = static_cast<std::uint8_t>(i);
+    EXPECT_EQ(IsContinuation(b), 0x80 <= b && b <= 0xbf);
+  }
+}
+
+TEST(IsOverlong3Byte, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b0 = static_cast<std::uint8_t>(i);
+    for (int j = 0x00; j <= 0xff; ++j) {
+      const std::uint8_t b1 = static_cast<std::uint8_t>(j);
+      EXPECT_EQ(IsOverlong3Byte(b0, b1), b0 == 0xe0 && b1 < 0xa0);
+    }
+  }
+}
+
+TEST(IsUtf16Surrogate, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b0 = static_cast<std::uint8_t>(i);
+    for (int j = 0x00; j <= 0xff; ++j) {
+      const std::uint8_t b1 = static_cast<std::uint8_t>(j);
+      EXPECT_EQ(IsUtf16Surrogate(b0, b1), b0 == 0xed && 0xa0 <= b1);
+    }
+  }
+}
+
+TEST(IsOverlong4Byte, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b0 = static_cast<std::uint8_t>(i);
+    for (int j = 0x00; j <= 0xff; ++j) {
+      const std::uint8_t b1 = static_cast<std::uint8_t>(j);
+      EXPECT_EQ(IsOverlong4Byte(b0, b1), b0 == 0xf0 && b1 < 0x90);
+    }
+  }
+}
+
+TEST(IsOutOfUnicodeRange, Basic) {
+  for (int i = 0x00; i <= 0xff; ++i) {
+    const std::uint8_t b0 = static_cast<std::uint8_t>(i);
+    for (int j = 0x00; j <= 0xff; ++j) {
+      const std::uint8_t b1 = static_cast<std::uint8_t>(j);
+      EXPECT_EQ(IsOutOfUnicodeRange(b0, b1), b0 == 0xf4 && 0x90 <= b1);
+    }
+  }
+}
+
+// A quick subset of `utf8_utils_exhaustive_test`.
+TEST(Differential, AllStringsUpTo2Bytes) {
+  char bytes[2]{};
+  for (std::uint32_t n = 0; n < (1 << 16); ++n) {
+    bytes[0] = static_cast<char>(n);
+    bytes[1] = static_cast<char>(n >> 8);
+    for (std::size_t length = n < (1 << 8) ? 1 : 2; length <= 2; ++length) {
+      const std::string_view str(bytes, length);
+      ASSERT_STREQ(differential::FindMismatch(str), nullptr)
+          << differential::Hex(str);
+    }
+  }
+}
+
+TEST(Differential, StringsOf3BoundaryBytesAfterFastPaths) {
+  char bytes[3]{};
+  for (const std::uint8_t b0 : differential::kBoundaryBytes) {
+    bytes[0] = static_cast<char>(b0);
+    for (const std::uint8_t b1 : differential::kBoundaryBytes) {
+      bytes[1] = static_cast<char>(b1);
+      for (const std::uint8_t b2 : differential::kBoundaryBytes) {
+        bytes[2] = static_cast<char>(b2);
+        const std::string_view str(bytes, 3);
+        ASSERT_STREQ(differential::FindMismatch(str), nullptr)
+            << differential::Hex(str);
+        ASSERT_STREQ(differential::FindMismatchAfterFastPaths(str), nullptr)
+            << differential::Hex(str);
+      }
+    }
+  }
+}
+
+}  // namespace utf8_utils
@@ -1,13 +1,23 @@
 #ifndef UTF8_UTILS_UTF8_UTILS_H_
 #define UTF8_UTILS_UTF8_UTILS_H_
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <variant>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace utf8_utils {
 
@@ -169,6 +179,10 @@ constexpr utf8_utils::TryResult TryToUtf32(const std::uint8_t b0,
     return utf8_utils::ErrorCode::kNotFirstOf3Bytes;
   }
 
+  if (!utf8_utils::IsContinuation(b1)) {
+    return utf8_utils::ErrorCode::kNotSecondIsContinuation;
+  }
+
   if (utf8_utils::IsOverlong3Byte(b0, b1)) {
     return utf8_utils::ErrorCode::kOverlongOf3Bytes;
   }
@@ -177,10 +191,6 @@ constexpr utf8_utils::TryResult TryToUtf32(const std::uint8_t b0,
     return utf8_utils::ErrorCode::kUtf16Surrogate;
   }
 
-  if (!utf8_utils::IsContinuation(b1)) {
-    return utf8_utils::ErrorCode::kNotSecondIsContinuation;
-  }
-
   if (!utf8_utils::IsContinuation(b2)) {
     return utf8_utils::ErrorCode::kNotThirdIsContinuation;
   }
@@ -196,6 +206,10 @@ constexpr utf8_utils::TryResult TryToUtf32(const std::uint8_t b0,
     return utf8_utils::ErrorCode::kNotFirstOf4Bytes;
   }
 
+  if (!utf8_utils::IsContinuation(b1)) {
+    return utf8_utils::ErrorCode::kNotSecondIsContinuation;
+  }
+
   if (utf8_utils::IsOverlong4Byte(b0, b1)) {
     return utf8_utils::ErrorCode::kOverlongOf4Bytes;
   }
@@ -204,10 +218,6 @@ constexpr utf8_utils::TryResult TryToUtf32(const std::uint8_t b0,
     return utf8_utils::ErrorCode::kOutOfUnicodeRange;
   }
 
-  if (!utf8_utils::IsContinuation(b1)) {
-    return utf8_utils::ErrorCode::kNotSecondIsContinuation;
-  }
-
   if (!utf8_utils::IsContinuation(b2)) {
     return utf8_utils::ErrorCode::kNotThirdIsContinuation;
   }
@@ -264,13 +274,13 @@ constexpr char32_t MustToUtf32(const std::uint8_t b0, const std::uint8_t b1,
                                const std::uint8_t b2) noexcept {
   assert(utf8_utils::Utf8BytesLength(b0) == 3 &&
          "Parameter `b0` must be a first byte of 3-byte UTF-8 character.");
+  assert(utf8_utils::IsContinuation(b1) &&
+         "Parameter `b1` must be a continuation byte.");
   assert(!utf8_utils::IsOverlong3Byte(b0, b1) &&
          "Parameter `b0` and `b1` must not form an overlong 3-byte UTF-8 "
          "character.");
   assert(!utf8_utils::IsUtf16Surrogate(b0, b1) &&
          "Parameter `b0` and `b1` must not form a UTF-16 surrogate.");
-  assert(utf8_utils::IsContinuation(b1) &&
-         "Parameter `b1` must be a continuation byte.");
   assert(utf8_utils::IsContinuation(b2) &&
          "Parameter `b2` must be a continuation byte.");
 
@@ -282,14 +292,14 @@ constexpr char32_t MustToUtf32(const std::uint8_t b0, const std::uint8_t b1,
                                const std::uint8_t b3) noexcept {
   assert(utf8_utils::Utf8BytesLength(b0) == 4 &&
          "Parameter `b0` must be a first byte of 4-byte UTF-8 character.");
+  assert(utf8_utils::IsContinuation(b1) &&
+         "Parameter `b1` must be a continuation byte.");
   assert(!utf8_utils::IsOverlong4Byte(b0, b1) &&
          "Parameter `b0` and `b1` must not form an overlong 4-byte UTF-8 "
          "character.");
   assert(!utf8_utils::IsOutOfUnicodeRange(b0, b1) &&
          "Parameter `b0` and `b1` must not form a character out of "
          "Unicode range.");
-  assert(utf8_utils::IsContinuation(b1) &&
-         "Parameter `b1` must be a continuation byte.");
   assert(utf8_utils::IsContinuation(b2) &&
          "Parameter `b2` must be a continuation byte.");
   assert(utf8_utils::IsContinuation(b3) &&
@@ -330,8 +340,384 @@ struct CheckError {
   std::size_t invalid_length{};
 };
 
+enum class DispatchPath : std::uint8_t {
+  kScalar,
+  kSwar,
+  kSse2,
+};
+
+constexpr std::size_t kErrorCodeCount =
+    static_cast<std::size_t>(utf8_utils::ErrorCode::kIncomplete4Bytes) + 1;
+
+constexpr std::size_t kDispatchPathCount =
+    static_cast<std::size_t>(utf8_utils::DispatchPath::kSse2) + 1;
+
+struct Stats {
+  std::uint64_t calls{};
+  std::uint64_t bytes_scanned{};
+  // Bytes consumed by the word or block ASCII fast paths. These are also
+  // counted in `sequences[0]`, so the ASCII share of the input is
+  // `sequences[0] / bytes_scanned` and the fast path hit rate is
+  // `fast_path_bytes / sequences[0]`.
+  std::uint64_t fast_path_bytes{};
+  // Indexed by the sequence length minus one.
+  std::array<std::uint64_t, 4> sequences{};
+  std::array<std::uint64_t, utf8_utils::kErrorCodeCount> errors{};
+  // Indexed by `DispatchPath`. Inputs shorter than a word are counted as
+  // `kScalar`, and calls with a null `str` take no path at all.
+  std::array<std::uint64_t, utf8_utils::kDispatchPathCount> dispatch_paths{};
+};
+
+namespace detail {
+
+// Metric labels. The switches have no default, so -Wswitch (part of -Wall)
+// flags an enumerator without a label, and the asserts below fail when an
+// enumerator is added past the one the count is derived from.
+constexpr std::string_view ErrorCodeName(
+    const utf8_utils::ErrorCode code) noexcept {
+  switch (code) {
+    case utf8_utils::ErrorCode::kUnexpected:
+      return "unexpected";
+    case utf8_utils::ErrorCode::kNotAscii:
+      return "not_ascii";
+    case utf8_utils::ErrorCode::kNotFirstOf2Bytes:
+      return "not_first_of_2_bytes";
+    case utf8_utils::ErrorCode::kNotFirstOf3Bytes:
+      return "not_first_of_3_bytes";
+    case utf8_utils::ErrorCode::kNotFirstOf4Bytes:
+      return "not_first_of_4_bytes";
+    case utf8_utils::ErrorCode::kNotSecondIsContinuation:
+      return "not_second_is_continuation";
+    case utf8_utils::ErrorCode::kNotThirdIsContinuation:
+      return "not_third_is_continuation";
+    case utf8_utils::ErrorCode::kNotFourthIsContinuation:
+      return "not_fourth_is_continuation";
+    case utf8_utils::ErrorCode::kOverlongOf3Bytes:
+      return "overlong_of_3_bytes";
+    case utf8_utils::ErrorCode::kUtf16Surrogate:
+      return "utf16_surrogate";
+    case utf8_utils::ErrorCode::kOverlongOf4Bytes:
+      return "overlong_of_4_bytes";
+    case utf8_utils::ErrorCode::kOutOfUnicodeRange:
+      return "out_of_unicode_range";
+    case utf8_utils::ErrorCode::kNullStringPtr:
+      return "null_string_ptr";
+    case utf8_utils::ErrorCode::kInvalidBytesLength:
+      return "invalid_bytes_length";
+    case utf8_utils::ErrorCode::kDisallowedFirstByte:
+      return "disallowed_first_byte";
+    case utf8_utils::ErrorCode::kIncomplete2Bytes:
+      return "incomplete_2_bytes";
+    case utf8_utils::ErrorCode::kIncomplete3Bytes:
+      return "incomplete_3_bytes";
+    case utf8_utils::ErrorCode::kIncomplete4Bytes:
+      return "incomplete_4_bytes";
+  }
+
+  return {};
+}
+
+constexpr std::string_view DispatchPathName(
+    const utf8_utils::DispatchPath path) noexcept {
+  switch (path) {
+    case utf8_utils::DispatchPath::kScalar:
+      return "scalar";
+    case utf8_utils::DispatchPath::kSwar:
+      return "swar";
+    case utf8_utils::DispatchPath::kSse2:
+      return "sse2";
+  }
+
+  return {};
+}
+
+static_assert(utf8_utils::detail::ErrorCodeName(
+                  static_cast<utf8_utils::ErrorCode>(
+                      utf8_utils::kErrorCodeCount))
+                  .empty(),
+              "kErrorCodeCount must cover every ErrorCode.");
+static_assert(utf8_utils::detail::DispatchPathName(
+                  static_cast<utf8_utils::DispatchPath>(
+                      utf8_utils::kDispatchPathCount))
+                  .empty(),
+              "kDispatchPathCount must cover every DispatchPath.");
+
+constexpr std::array<std::string_view, 4> kSequenceNames = {"1", "2", "3", "4"};
+
+constexpr std::size_t kStatsCounterCount =
+    3 + 4 + utf8_utils::kErrorCodeCount + utf8_utils::kDispatchPathCount;
+
+// Calls `visitor(name, label, counter)` for every counter of `stats` in a
+// fixed order. `label` is empty for counters that are not broken down.
+template <typename StatsT, typename Visitor>
+constexpr void VisitCounters(StatsT& stats, Visitor&& visitor) {
+  visitor("calls", "", stats.calls);
+  visitor("bytes_scanned", "", stats.bytes_scanned);
+  visitor("fast_path_bytes", "", stats.fast_path_bytes);
+  for (std::size_t k = 0; k < stats.sequences.size(); ++k) {
+    visitor("sequences", utf8_utils::detail::kSequenceNames[k],
+            stats.sequences[k]);
+  }
+
+  for (std::size_t k = 0; k < stats.errors.size(); ++k) {
+    visitor("errors",
+            utf8_utils::detail::ErrorCodeName(
+                static_cast<utf8_utils::ErrorCode>(k)),
+            stats.errors[k]);
+  }
+
+  for (std::size_t k = 0; k < stats.dispatch_paths.size(); ++k) {
+    visitor("dispatch_paths",
+            utf8_utils::detail::DispatchPathName(
+                static_cast<utf8_utils::DispatchPath>(k)),
+            stats.dispatch_paths[k]);
+  }
+}
+
+// Each thread only writes its own slot, so a relaxed load and store is enough
+// for the owner while other threads read it concurrently.
+struct StatsSlot {
+  std::array<std::atomic<std::uint64_t>, utf8_utils::detail::kStatsCounterCount>
+      counters{};
+};
+
+inline std::array<std::uint64_t, utf8_utils::detail::kStatsCounterCount>
+ToCounters(const utf8_utils::Stats& stats) noexcept {
+  std::array<std::uint64_t, utf8_utils::detail::kStatsCounterCount> counters{};
+  std::size_t k{};
+  utf8_utils::detail::VisitCounters(
+      stats,
+      [&](std::string_view, std::string_view, const std::uint64_t counter) {
+        counters[k++] = counter;
+      });
+  return counters;
+}
+
+class StatsRegistry {
+ public:
+  void Register(utf8_utils::detail::StatsSlot* slot) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    slots_.push_back(slot);
+  }
+
+  void Unregister(utf8_utils::detail::StatsSlot* slot) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    AddSlot(retired_, *slot);
+    slots_.erase(std::find(slots_.begin(), slots_.end(), slot));
+  }
+
+  utf8_utils::Stats Collect() {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    utf8_utils::Stats stats = Total();
+    std::size_t k{};
+    utf8_utils::detail::VisitCounters(
+        stats, [&](std::string_view, std::string_view, std::uint64_t& counter) {
+          counter -= baseline_[k++];
+        });
+    return stats;
+  }
+
+  // Later collections are reported relative to the current totals, so
+  // resetting never races with threads that are recording.
+  void Reset() {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    baseline_ = utf8_utils::detail::ToCounters(Total());
+  }
+
+ private:
+  static void AddSlot(utf8_utils::Stats& stats,
+                      const utf8_utils::detail::StatsSlot& slot) noexcept {
+    std::size_t k{};
+    utf8_utils::detail::VisitCounters(
+        stats, [&](std::string_view, std::string_view, std::uint64_t& counter) {
+          counter += slot.counters[k++].load(std::memory_order_relaxed);
+        });
+  }
+
+  utf8_utils::Stats Total() const {
+    utf8_utils::Stats stats = retired_;
+    for (const utf8_utils::detail::StatsSlot* slot : slots_) {
+      AddSlot(stats, *slot);
+    }
+
+    return stats;
+  }
+
+  std::mutex mutex_;
+  std::vector<utf8_utils::detail::StatsSlot*> slots_;
+  utf8_utils::Stats retired_;
+  std::array<std::uint64_t, utf8_utils::detail::kStatsCounterCount> baseline_{};
+};
+
+inline utf8_utils::detail::StatsRegistry& GetStatsRegistry() {
+  static utf8_utils::detail::StatsRegistry registry;
+  return registry;
+}
+
+class ThreadStatsSlot : public utf8_utils::detail::StatsSlot {
+ public:
+  ThreadStatsSlot() { utf8_utils::detail::GetStatsRegistry().Register(this); }
+  ~ThreadStatsSlot() {
+    utf8_utils::detail::GetStatsRegistry().Unregister(this);
+  }
+
+  ThreadStatsSlot(const ThreadStatsSlot&) = delete;
+  ThreadStatsSlot& operator=(const ThreadStatsSlot&) = delete;
+};
+
+inline utf8_utils::detail::StatsSlot& GetThreadStatsSlot() {
+  thread_local utf8_utils::detail::ThreadStatsSlot slot;
+  return slot;
+}
+
+}  // namespace detail
+
+// Stats policies select at compile time whether the scanning functions record
+// `Stats`. A custom policy sets `kEnabled` and provides a static
+// `Record(const Stats&)`, which is called once per scanning call.
+struct NoStats {
+  static constexpr bool kEnabled = false;
+};
+
+// Records into a per-thread slot. `CollectStats` merges all of them on demand.
+struct ThreadLocalStats {
+  static constexpr bool kEnabled = true;
+
+  static void Record(const utf8_utils::Stats& stats) noexcept {
+    auto& counters = utf8_utils::detail::GetThreadStatsSlot().counters;
+    std::size_t k{};
+    utf8_utils::detail::VisitCounters(
+        stats,
+        [&](std::string_view, std::string_view, const std::uint64_t counter) {
+          std::atomic<std::uint64_t>& slot_counter = counters[k++];
+          slot_counter.store(
+              slot_counter.load(std::memory_order_relaxed) + counter,
+              std::memory_order_relaxed);
+        });
+  }
+};
+
+// Returns what `ThreadLocalStats` recorded on all threads since the last
+// `ResetStats`.
+inline utf8_utils::Stats CollectStats() {
+  return utf8_utils::detail::GetStatsRegistry().Collect();
+}
+
+inline void ResetStats() { utf8_utils::detail::GetStatsRegistry().Reset(); }
+
+// Export hook: calls `visitor(name, label, value)` for every counter, e.g.
+// `("errors", "utf16_surrogate", 3)` or `("bytes_scanned", "", 4096)`.
+template <typename Visitor>
+void VisitStats(const utf8_utils::Stats& stats, Visitor&& visitor) {
+  utf8_utils::detail::VisitCounters(
+      stats, [&](const std::string_view name, const std::string_view label,
+                 const std::uint64_t value) { visitor(name, label, value); });
+}
+
 namespace detail {
 
+template <typename StatsPolicy, bool = StatsPolicy::kEnabled>
+class ScanRecorder {
+ public:
+  constexpr void OnAsciiRun(const std::size_t length) noexcept {
+    stats_.fast_path_bytes += length;
+    stats_.sequences[0] += length;
+  }
+
+  constexpr void OnSequence(const std::size_t bytes_length) noexcept {
+    ++stats_.sequences[bytes_length - 1];
+  }
+
+  constexpr void OnError(const utf8_utils::CheckError& err) noexcept {
+    ++stats_.errors[static_cast<std::size_t>(err.code)];
+  }
+
+  // Used for calls rejected before any byte is scanned, which take no path.
+  void Finish(const std::size_t bytes_scanned) noexcept {
+    ++stats_.calls;
+    stats_.bytes_scanned += bytes_scanned;
+    StatsPolicy::Record(stats_);
+  }
+
+  void Finish(const std::size_t bytes_scanned,
+              const utf8_utils::DispatchPath path) noexcept {
+    ++stats_.dispatch_paths[static_cast<std::size_t>(path)];
+    Finish(bytes_scanned);
+  }
+
+ private:
+  utf8_utils::Stats stats_;
+};
+
+template <typename StatsPolicy>
+class ScanRecorder<StatsPolicy, false> {
+ public:
+  constexpr void OnAsciiRun(const std::size_t) noexcept {}
+  constexpr void OnSequence(const std::size_t) noexcept {}
+  constexpr void OnError(const utf8_utils::CheckError&) noexcept {}
+  constexpr void Finish(const std::size_t) noexcept {}
+  constexpr void Finish(const std::size_t,
+                        const utf8_utils::DispatchPath) noexcept {}
+};
+
+constexpr std::size_t kWordSize = sizeof(std::uint64_t);
+constexpr std::uint64_t kWordHighBits = 0x8080808080808080;
+
+// The word loops only load a word while at least `kWordSize` bytes remain, so
+// shorter inputs are checked byte by byte.
+constexpr utf8_utils::DispatchPath WordLoopPath(
+    const std::size_t len) noexcept {
+  return len >= utf8_utils::detail::kWordSize
+             ? utf8_utils::DispatchPath::kSwar
+             : utf8_utils::DispatchPath::kScalar;
+}
+
+constexpr std::uint64_t WordByte(const char* str,
+                                 const unsigned k) noexcept {
+  return std::uint64_t{static_cast<std::uint8_t>(str[k])} << k * 8;
+}
+
+// Words hold bytes in string order starting from the least significant byte.
+// Assembled byte by byte so that `Check` stays usable in constant
+// expressions; GCC and Clang merge this into a single load.
+constexpr std::uint64_t LoadWord(const char* str) noexcept {
+  return utf8_utils::detail::WordByte(str, 0) |
+         utf8_utils::detail::WordByte(str, 1) |
+         utf8_utils::detail::WordByte(str, 2) |
+         utf8_utils::detail::WordByte(str, 3) |
+         utf8_utils::detail::WordByte(str, 4) |
+         utf8_utils::detail::WordByte(str, 5) |
+         utf8_utils::detail::WordByte(str, 6) |
+         utf8_utils::detail::WordByte(str, 7);
+}
+
+inline void StoreWord(char* out, std::uint64_t word) noexcept {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  std::memcpy(out, &word, sizeof(word));
+}
+
+constexpr bool IsAsciiWord(const std::uint64_t word) noexcept {
+  return (word & utf8_utils::detail::kWordHighBits) == 0;
+}
+
+// Returns how many bytes at the start of `word` are ASCII. Requires
+// `!IsAsciiWord(word)`.
+constexpr std::size_t AsciiPrefixLength(const std::uint64_t word) noexcept {
+  const std::uint64_t high_bits = word & utf8_utils::detail::kWordHighBits;
+#if defined(__GNUC__)
+  return static_cast<std::size_t>(__builtin_ctzll(high_bits)) / 8;
+#else
+  std::size_t length{};
+  while ((high_bits >> (length * 8 + 7) & 1) == 0) {
+    ++length;
+  }
+
+  return length;
+#endif
+}
+
 constexpr std::optional<utf8_utils::CheckError> Check2Bytes(
     const char* str, const std::size_t len, const std::size_t start,
     const std::uint8_t b0, std::size_t& i) noexcept {
@@ -359,6 +745,11 @@ constexpr std::optional<utf8_utils::CheckError> Check3Bytes(
   }
 
   const std::uint8_t b1 = str[i];
+  if (!utf8_utils::IsContinuation(b1)) {
+    return utf8_utils::CheckError{
+        utf8_utils::ErrorCode::kNotSecondIsContinuation, start, i - start};
+  }
+
   if (utf8_utils::IsOverlong3Byte(b0, b1)) {
     ++i;
     return utf8_utils::CheckError{utf8_utils::ErrorCode::kOverlongOf3Bytes,
@@ -371,11 +762,6 @@ constexpr std::optional<utf8_utils::CheckError> Check3Bytes(
                                   i - start};
   }
 
-  if (!utf8_utils::IsContinuation(b1)) {
-    return utf8_utils::CheckError{
-        utf8_utils::ErrorCode::kNotSecondIsContinuation, start, i - start};
-  }
-
   ++i;
   if (i >= len) {
     return utf8_utils::CheckError{utf8_utils::ErrorCode::kIncomplete3Bytes,
@@ -401,6 +787,11 @@ constexpr std::optional<utf8_utils::CheckError> Check4Bytes(
   }
 
   const std::uint8_t b1 = str[i];
+  if (!utf8_utils::IsContinuation(b1)) {
+    return utf8_utils::CheckError{
+        utf8_utils::ErrorCode::kNotSecondIsContinuation, start, i - start};
+  }
+
   if (utf8_utils::IsOverlong4Byte(b0, b1)) {
     ++i;
     return utf8_utils::CheckError{utf8_utils::ErrorCode::kOverlongOf4Bytes,
@@ -413,11 +804,6 @@ constexpr std::optional<utf8_utils::CheckError> Check4Bytes(
                                   start, i - start};
   }
 
-  if (!utf8_utils::IsContinuation(b1)) {
-    return utf8_utils::CheckError{
-        utf8_utils::ErrorCode::kNotSecondIsContinuation, start, i - start};
-  }
-
   ++i;
   if (i >= len) {
     return utf8_utils::CheckError{utf8_utils::ErrorCode::kIncomplete4Bytes,
@@ -446,73 +832,103 @@ constexpr std::optional<utf8_utils::CheckError> Check4Bytes(
   return std::nullopt;
 }
 
-}  // namespace detail
+constexpr std::optional<utf8_utils::CheckError> CheckSequence(
+    const char* str, const std::size_t len, std::size_t& i) noexcept {
+  const std::size_t start = i;
+  const std::uint8_t b0 = str[i++];
+  if (b0 <= 0x7f) {
+    return std::nullopt;
+  }
 
-constexpr std::optional<utf8_utils::CheckError> Check(
-    const char* str, const std::size_t len) noexcept {
-  if (str == nullptr) {
-    return utf8_utils::CheckError{utf8_utils::ErrorCode::kNullStringPtr, 0, 0};
+  const std::uint8_t bytes_length = utf8_utils::Utf8BytesLength(b0);
+  if (bytes_length == 0) {
+    return utf8_utils::CheckError{utf8_utils::ErrorCode::kDisallowedFirstByte,
+                                  start, i - start};
   }
 
-  if (len == 0) {
-    return std::nullopt;
+  if (bytes_length == 2) {
+    return utf8_utils::detail::Check2Bytes(str, len, start, b0, i);
   }
 
-  std::size_t i{};
-  while (i < len) {
-    const std::size_t start = i;
-    const std::uint8_t b0 = str[i++];
-    const std::uint8_t len = utf8_utils::Utf8BytesLength(b0);
+  if (bytes_length == 3) {
+    return utf8_utils::detail::Check3Bytes(str, len, start, b0, i);
+  }
 
-    if (len == 0) {
-      return utf8_utils::CheckError{utf8_utils::ErrorCode::kDisallowedFirstByte,
-                                    start, i - start};
-    }
+  if (bytes_length == 4) {
+    return utf8_utils::detail::Check4Bytes(str, len, start, b0, i);
+  }
 
-    if (len == 1) {
-      continue;
-    }
+  return std::nullopt;
+}
 
-    if (len == 2) {
-      if (auto err = utf8_utils::detail::Check2Bytes(str, len, start, b0, i);
-          err) {
-        return err;
+// Checks `str` up to the first error like `Check`, but leaves finishing
+// `recorder` to the caller so that callers which resume after an error still
+// record a single call.
+template <typename Recorder>
+constexpr std::optional<utf8_utils::CheckError> CheckSequences(
+    const char* str, const std::size_t len, Recorder& recorder) noexcept {
+  std::size_t i{};
+  while (i < len) {
+    if (len - i >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word = utf8_utils::detail::LoadWord(str + i);
+      if (utf8_utils::detail::IsAsciiWord(word)) {
+        recorder.OnAsciiRun(utf8_utils::detail::kWordSize);
+        i += utf8_utils::detail::kWordSize;
+        continue;
       }
 
-      continue;
+      const std::size_t ascii_length =
+          utf8_utils::detail::AsciiPrefixLength(word);
+      recorder.OnAsciiRun(ascii_length);
+      i += ascii_length;
     }
 
-    if (len == 3) {
-      if (auto err = utf8_utils::detail::Check3Bytes(str, len, start, b0, i);
-          err) {
-        return err;
-      }
-
-      continue;
+    const std::size_t start = i;
+    if (auto err = utf8_utils::detail::CheckSequence(str, len, i); err) {
+      recorder.OnError(*err);
+      return err;
     }
 
-    if (len == 4) {
-      if (auto err = utf8_utils::detail::Check4Bytes(str, len, start, b0, i);
-          err) {
-        return err;
-      }
-
-      continue;
-    }
+    recorder.OnSequence(i - start);
   }
 
   return std::nullopt;
 }
 
+}  // namespace detail
+
+template <typename StatsPolicy = utf8_utils::NoStats>
+constexpr std::optional<utf8_utils::CheckError> Check(
+    const char* str, const std::size_t len) noexcept {
+  utf8_utils::detail::ScanRecorder<StatsPolicy> recorder{};
+  if (str == nullptr) {
+    const utf8_utils::CheckError err{utf8_utils::ErrorCode::kNullStringPtr, 0,
+                                     0};
+    recorder.OnError(err);
+    recorder.Finish(0);
+    return err;
+  }
+
+  auto err = utf8_utils::detail::CheckSequences(str, len, recorder);
+  recorder.Finish(err ? err->invalid_position + err->invalid_length : len,
+                  utf8_utils::detail::WordLoopPath(len));
+  return err;
+}
+
+template <typename StatsPolicy = utf8_utils::NoStats>
 constexpr std::optional<utf8_utils::CheckError> Check(
     std::string_view str) noexcept {
-  return utf8_utils::Check(str.data(), str.size());
+  return utf8_utils::Check<StatsPolicy>(str.data(), str.size());
 }
 
-constexpr std::string ToLossy(const char* str, std::size_t len) noexcept {
+template <typename StatsPolicy = utf8_utils::NoStats>
+inline std::string ToLossy(const char* str, std::size_t len) noexcept {
+  utf8_utils::detail::ScanRecorder<StatsPolicy> recorder{};
+  const std::size_t bytes_scanned = len;
   std::string result;
   while (len > 0) {
-    if (auto err = utf8_utils::Check(str, len); err) {
+    if (auto err = utf8_utils::detail::CheckSequences(str, len, recorder);
+        err) {
       result.append(str, err->invalid_position);
       result.append("�");
       const std::size_t advance = err->invalid_position + err->invalid_length;
@@ -525,18 +941,25 @@ constexpr std::string ToLossy(const char* str, std::size_t len) noexcept {
     }
   }
 
+  recorder.Finish(bytes_scanned,
+                  utf8_utils::detail::WordLoopPath(bytes_scanned));
   return result;
 }
 
-constexpr std::string ToLossy(std::string_view str) noexcept {
-  return utf8_utils::ToLossy(str.data(), str.size());
+template <typename StatsPolicy = utf8_utils::NoStats>
+inline std::string ToLossy(std::string_view str) noexcept {
+  return utf8_utils::ToLossy<StatsPolicy>(str.data(), str.size());
 }
 
-constexpr std::optional<std::string> ToLossyIfInvalid(
+template <typename StatsPolicy = utf8_utils::NoStats>
+inline std::optional<std::string> ToLossyIfInvalid(
     const char* str, std::size_t len) noexcept {
+  utf8_utils::detail::ScanRecorder<StatsPolicy> recorder{};
+  const std::size_t bytes_scanned = len;
   std::optional<std::string> result;
   while (len > 0) {
-    if (auto err = utf8_utils::Check(str, len); err) {
+    if (auto err = utf8_utils::detail::CheckSequences(str, len, recorder);
+        err) {
       if (!result) {
         result = std::make_optional("");
       }
@@ -549,18 +972,773 @@ constexpr std::optional<std::string> ToLossyIfInvalid(
     } else {
       if (result) {
         result->append(str, len);
-        str += len;
-        len -= len;
       }
+
+      str += len;
+      len -= len;
     }
   }
 
+  recorder.Finish(bytes_scanned,
+                  utf8_utils::detail::WordLoopPath(bytes_scanned));
   return result;
 }
 
-constexpr std::optional<std::string> ToLossyIfInvalid(
+template <typename StatsPolicy = utf8_utils::NoStats>
+inline std::optional<std::string> ToLossyIfInvalid(
     std::string_view str) noexcept {
-  return utf8_utils::ToLossyIfInvalid(str.data(), str.size());
+  return utf8_utils::ToLossyIfInvalid<StatsPolicy>(str.data(), str.size());
+}
+
+// A sequence `[position, position + length)` decoded the way `Check` splits
+// its input: either a code point or the error `Check` reports for it.
+struct DecodedSequence {
+  utf8_utils::TryResult result{utf8_utils::ErrorCode::kUnexpected};
+  std::size_t position{};
+  std::size_t length{};
+};
+
+// Decodes the sequence that ends at `pos`, looking back at most 4 bytes.
+// Returns `std::nullopt` at the start of `str`. If `pos` splits a sequence,
+// the bytes before it are decoded as if `str` ended at `pos`.
+constexpr std::optional<utf8_utils::DecodedSequence> PrevCodePoint(
+    std::string_view str, const std::size_t pos) noexcept {
+  assert(pos <= str.size() &&
+         "Parameter `pos` must not be greater than the string size.");
+
+  if (pos == 0) {
+    return std::nullopt;
+  }
+
+  std::size_t start = pos - 1;
+  while (start > 0 && pos - start < 4 &&
+         utf8_utils::IsContinuation(str[start])) {
+    --start;
+  }
+
+  if (!utf8_utils::IsContinuation(str[start])) {
+    std::size_t i = start;
+    auto err = utf8_utils::detail::CheckSequence(str.data(), str.size(), i);
+    if (i > pos) {
+      i = start;
+      err = utf8_utils::detail::CheckSequence(str.data(), pos, i);
+    }
+
+    if (i == pos) {
+      if (err) {
+        return utf8_utils::DecodedSequence{err->code, start, pos - start};
+      }
+
+      return utf8_utils::DecodedSequence{
+          utf8_utils::MustToUtf32(str.substr(start, pos - start)), start,
+          pos - start};
+    }
+  }
+
+  // Continuation bytes that no lead byte covers are reported one by one.
+  return utf8_utils::DecodedSequence{
+      utf8_utils::ErrorCode::kDisallowedFirstByte, pos - 1, 1};
+}
+
+// Returns the start of the sequence that contains the byte at `pos`, looking
+// back at most 3 bytes. Offsets past the end are clamped to `str.size()`.
+constexpr std::size_t AlignToBoundary(std::string_view str,
+                                      const std::size_t pos) noexcept {
+  if (pos >= str.size()) {
+    return str.size();
+  }
+
+  std::size_t start = pos;
+  while (start > 0 && pos - start < 3 &&
+         utf8_utils::IsContinuation(str[start])) {
+    --start;
+  }
+
+  if (start == pos || utf8_utils::IsContinuation(str[start])) {
+    return pos;
+  }
+
+  std::size_t i = start;
+  utf8_utils::detail::CheckSequence(str.data(), str.size(), i);
+  return i > pos ? start : pos;
+}
+
+// Iterates the sequences of a string backwards from a position, yielding
+// exactly what `PrevCodePoint` decodes.
+class ReverseIterator {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = utf8_utils::DecodedSequence;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const utf8_utils::DecodedSequence*;
+  using reference = const utf8_utils::DecodedSequence&;
+
+  constexpr ReverseIterator() noexcept = default;
+
+  constexpr ReverseIterator(std::string_view str,
+                            const std::size_t pos) noexcept
+      : str_{str} {
+    Decode(pos);
+  }
+
+  constexpr reference operator*() const noexcept { return sequence_; }
+
+  constexpr pointer operator->() const noexcept { return &sequence_; }
+
+  constexpr ReverseIterator& operator++() noexcept {
+    Decode(sequence_.position);
+    return *this;
+  }
+
+  constexpr ReverseIterator operator++(int) noexcept {
+    ReverseIterator it = *this;
+    ++*this;
+    return it;
+  }
+
+  // Iterators compare by the position they decode backwards from, so any
+  // iterator that reached the start of its string equals the default one.
+  friend constexpr bool operator==(const ReverseIterator& lhs,
+                                   const ReverseIterator& rhs) noexcept {
+    return lhs.pos_ == rhs.pos_;
+  }
+
+  friend constexpr bool operator!=(const ReverseIterator& lhs,
+                                   const ReverseIterator& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+ private:
+  constexpr void Decode(const std::size_t pos) noexcept {
+    pos_ = pos;
+    if (auto sequence = utf8_utils::PrevCodePoint(str_, pos); sequence) {
+      sequence_ = *sequence;
+    }
+  }
+
+  std::string_view str_;
+  std::size_t pos_{};
+  utf8_utils::DecodedSequence sequence_;
+};
+
+struct ReverseRange {
+  std::string_view str;
+  std::size_t pos{};
+
+  constexpr utf8_utils::ReverseIterator begin() const noexcept {
+    return utf8_utils::ReverseIterator{str, pos};
+  }
+
+  constexpr utf8_utils::ReverseIterator end() const noexcept {
+    return utf8_utils::ReverseIterator{};
+  }
+};
+
+// Iterates the sequences before `pos` from the last one to the first.
+constexpr utf8_utils::ReverseRange Reversed(
+    std::string_view str,
+    const std::size_t pos = std::string_view::npos) noexcept {
+  return utf8_utils::ReverseRange{str, pos < str.size() ? pos : str.size()};
+}
+
+namespace detail {
+
+struct CaseFoldRange {
+  char32_t first{};
+  std::uint16_t length{};
+  std::uint8_t stride{};
+  std::int32_t delta{};
+};
+
+// Unicode 14.0 simple case folding (CaseFolding.txt, statuses C and S).
+// `first + k * stride` folds to itself plus `delta` for each `k < length`.
+constexpr std::array<utf8_utils::detail::CaseFoldRange, 202>
+    kCaseFoldRanges = {{
+    {0x00041, 26, 1, 32}, {0x000b5, 1, 1, 775}, {0x000c0, 23, 1, 32},
+    {0x000d8, 7, 1, 32}, {0x00100, 24, 2, 1}, {0x00132, 3, 2, 1},
+    {0x00139, 8, 2, 1}, {0x0014a, 23, 2, 1}, {0x00178, 1, 1, -121},
+    {0x00179, 3, 2, 1}, {0x0017f, 1, 1, -268}, {0x00181, 1, 1, 210},
+    {0x00182, 2, 2, 1}, {0x00186, 1, 1, 206}, {0x00187, 1, 1, 1},
+    {0x00189, 2, 1, 205}, {0x0018b, 1, 1, 1}, {0x0018e, 1, 1, 79},
+    {0x0018f, 1, 1, 202}, {0x00190, 1, 1, 203}, {0x00191, 1, 1, 1},
+    {0x00193, 1, 1, 205}, {0x00194, 1, 1, 207}, {0x00196, 1, 1, 211},
+    {0x00197, 1, 1, 209}, {0x00198, 1, 1, 1}, {0x0019c, 1, 1, 211},
+    {0x0019d, 1, 1, 213}, {0x0019f, 1, 1, 214}, {0x001a0, 3, 2, 1},
+    {0x001a6, 1, 1, 218}, {0x001a7, 1, 1, 1}, {0x001a9, 1, 1, 218},
+    {0x001ac, 1, 1, 1}, {0x001ae, 1, 1, 218}, {0x001af, 1, 1, 1},
+    {0x001b1, 2, 1, 217}, {0x001b3, 2, 2, 1}, {0x001b7, 1, 1, 219},
+    {0x001b8, 1, 1, 1}, {0x001bc, 1, 1, 1}, {0x001c4, 1, 1, 2},
+    {0x001c5, 1, 1, 1}, {0x001c7, 1, 1, 2}, {0x001c8, 1, 1, 1},
+    {0x001ca, 1, 1, 2}, {0x001cb, 9, 2, 1}, {0x001de, 9, 2, 1},
+    {0x001f1, 1, 1, 2}, {0x001f2, 2, 2, 1}, {0x001f6, 1, 1, -97},
+    {0x001f7, 1, 1, -56}, {0x001f8, 20, 2, 1}, {0x00220, 1, 1, -130},
+    {0x00222, 9, 2, 1}, {0x0023a, 1, 1, 10795}, {0x0023b, 1, 1, 1},
+    {0x0023d, 1, 1, -163}, {0x0023e, 1, 1, 10792}, {0x00241, 1, 1, 1},
+    {0x00243, 1, 1, -195}, {0x00244, 1, 1, 69}, {0x00245, 1, 1, 71},
+    {0x00246, 5, 2, 1}, {0x00345, 1, 1, 116}, {0x00370, 2, 2, 1},
+    {0x00376, 1, 1, 1}, {0x0037f, 1, 1, 116}, {0x00386, 1, 1, 38},
+    {0x00388, 3, 1, 37}, {0x0038c, 1, 1, 64}, {0x0038e, 2, 1, 63},
+    {0x00391, 17, 1, 32}, {0x003a3, 9, 1, 32}, {0x003c2, 1, 1, 1},
+    {0x003cf, 1, 1, 8}, {0x003d0, 1, 1, -30}, {0x003d1, 1, 1, -25},
+    {0x003d5, 1, 1, -15}, {0x003d6, 1, 1, -22}, {0x003d8, 12, 2, 1},
+    {0x003f0, 1, 1, -54}, {0x003f1, 1, 1, -48}, {0x003f4, 1, 1, -60},
+    {0x003f5, 1, 1, -64}, {0x003f7, 1, 1, 1}, {0x003f9, 1, 1, -7},
+    {0x003fa, 1, 1, 1}, {0x003fd, 3, 1, -130}, {0x00400, 16, 1, 80},
+    {0x00410, 32, 1, 32}, {0x00460, 17, 2, 1}, {0x0048a, 27, 2, 1},
+    {0x004c0, 1, 1, 15}, {0x004c1, 7, 2, 1}, {0x004d0, 48, 2, 1},
+    {0x00531, 38, 1, 48}, {0x010a0, 38, 1, 7264}, {0x010c7, 1, 1, 7264},
+    {0x010cd, 1, 1, 7264}, {0x013f8, 6, 1, -8}, {0x01c80, 1, 1, -6222},
+    {0x01c81, 1, 1, -6221}, {0x01c82, 1, 1, -6212}, {0x01c83, 2, 1, -6210},
+    {0x01c85, 1, 1, -6211}, {0x01c86, 1, 1, -6204}, {0x01c87, 1, 1, -6180},
+    {0x01c88, 1, 1, 35267}, {0x01c90, 43, 1, -3008}, {0x01cbd, 3, 1, -3008},
+    {0x01e00, 75, 2, 1}, {0x01e9b, 1, 1, -58}, {0x01e9e, 1, 1, -7615},
+    {0x01ea0, 48, 2, 1}, {0x01f08, 8, 1, -8}, {0x01f18, 6, 1, -8},
+    {0x01f28, 8, 1, -8}, {0x01f38, 8, 1, -8}, {0x01f48, 6, 1, -8},
+    {0x01f59, 4, 2, -8}, {0x01f68, 8, 1, -8}, {0x01f88, 8, 1, -8},
+    {0x01f98, 8, 1, -8}, {0x01fa8, 8, 1, -8}, {0x01fb8, 2, 1, -8},
+    {0x01fba, 2, 1, -74}, {0x01fbc, 1, 1, -9}, {0x01fbe, 1, 1, -7173},
+    {0x01fc8, 4, 1, -86}, {0x01fcc, 1, 1, -9}, {0x01fd8, 2, 1, -8},
+    {0x01fda, 2, 1, -100}, {0x01fe8, 2, 1, -8}, {0x01fea, 2, 1, -112},
+    {0x01fec, 1, 1, -7}, {0x01ff8, 2, 1, -128}, {0x01ffa, 2, 1, -126},
+    {0x01ffc, 1, 1, -9}, {0x02126, 1, 1, -7517}, {0x0212a, 1, 1, -8383},
+    {0x0212b, 1, 1, -8262}, {0x02132, 1, 1, 28}, {0x02160, 16, 1, 16},
+    {0x02183, 1, 1, 1}, {0x024b6, 26, 1, 26}, {0x02c00, 48, 1, 48},
+    {0x02c60, 1, 1, 1}, {0x02c62, 1, 1, -10743}, {0x02c63, 1, 1, -3814},
+    {0x02c64, 1, 1, -10727}, {0x02c67, 3, 2, 1}, {0x02c6d, 1, 1, -10780},
+    {0x02c6e, 1, 1, -10749}, {0x02c6f, 1, 1, -10783}, {0x02c70, 1, 1, -10782},
+    {0x02c72, 1, 1, 1}, {0x02c75, 1, 1, 1}, {0x02c7e, 2, 1, -10815},
+    {0x02c80, 50, 2, 1}, {0x02ceb, 2, 2, 1}, {0x02cf2, 1, 1, 1},
+    {0x0a640, 23, 2, 1}, {0x0a680, 14, 2, 1}, {0x0a722, 7, 2, 1},
+    {0x0a732, 31, 2, 1}, {0x0a779, 2, 2, 1}, {0x0a77d, 1, 1, -35332},
+    {0x0a77e, 5, 2, 1}, {0x0a78b, 1, 1, 1}, {0x0a78d, 1, 1, -42280},
+    {0x0a790, 2, 2, 1}, {0x0a796, 10, 2, 1}, {0x0a7aa, 1, 1, -42308},
+    {0x0a7ab, 1, 1, -42319}, {0x0a7ac, 1, 1, -42315}, {0x0a7ad, 1, 1, -42305},
+    {0x0a7ae, 1, 1, -42308}, {0x0a7b0, 1, 1, -42258}, {0x0a7b1, 1, 1, -42282},
+    {0x0a7b2, 1, 1, -42261}, {0x0a7b3, 1, 1, 928}, {0x0a7b4, 8, 2, 1},
+    {0x0a7c4, 1, 1, -48}, {0x0a7c5, 1, 1, -42307}, {0x0a7c6, 1, 1, -35384},
+    {0x0a7c7, 2, 2, 1}, {0x0a7d0, 1, 1, 1}, {0x0a7d6, 2, 2, 1},
+    {0x0a7f5, 1, 1, 1}, {0x0ab70, 80, 1, -38864}, {0x0ff21, 26, 1, 32},
+    {0x10400, 40, 1, 40}, {0x104b0, 36, 1, 40}, {0x10570, 11, 1, 39},
+    {0x1057c, 15, 1, 39}, {0x1058c, 7, 1, 39}, {0x10594, 2, 1, 39},
+    {0x10c80, 51, 1, 64}, {0x118a0, 32, 1, 32}, {0x16e40, 32, 1, 32},
+    {0x1e900, 34, 1, 34},
+}};
+
+// Bytes that do not start a valid sequence are decoded as this base plus the
+// byte itself, so they never compare equal to a code point.
+constexpr char32_t kInvalidUnitBase = 0x110000;
+
+constexpr char32_t DecodeUnit(const char* str, const std::size_t len,
+                              std::size_t& i) noexcept {
+  const std::uint8_t b0 = str[i];
+  const std::uint8_t bytes_length = utf8_utils::Utf8BytesLength(b0);
+  if (bytes_length == 1) {
+    ++i;
+    return b0;
+  }
+
+  if (bytes_length != 0 && bytes_length <= len - i) {
+    if (auto result = utf8_utils::TryToUtf32(str + i, bytes_length);
+        utf8_utils::HasValue(result)) {
+      i += bytes_length;
+      return utf8_utils::MustValue(result);
+    }
+  }
+
+  ++i;
+  return utf8_utils::detail::kInvalidUnitBase + b0;
+}
+
+constexpr std::size_t EncodeUnit(const char32_t unit, char* out) noexcept {
+  if (unit < 0x80) {
+    out[0] = static_cast<char>(unit);
+    return 1;
+  }
+
+  if (unit < 0x800) {
+    out[0] = static_cast<char>(0b11000000 | unit >> 6);
+    out[1] = static_cast<char>(0b10000000 | (unit & 0b00111111));
+    return 2;
+  }
+
+  if (unit < 0x10000) {
+    out[0] = static_cast<char>(0b11100000 | unit >> 12);
+    out[1] = static_cast<char>(0b10000000 | (unit >> 6 & 0b00111111));
+    out[2] = static_cast<char>(0b10000000 | (unit & 0b00111111));
+    return 3;
+  }
+
+  if (unit < utf8_utils::detail::kInvalidUnitBase) {
+    out[0] = static_cast<char>(0b11110000 | unit >> 18);
+    out[1] = static_cast<char>(0b10000000 | (unit >> 12 & 0b00111111));
+    out[2] = static_cast<char>(0b10000000 | (unit >> 6 & 0b00111111));
+    out[3] = static_cast<char>(0b10000000 | (unit & 0b00111111));
+    return 4;
+  }
+
+  out[0] = static_cast<char>(unit - utf8_utils::detail::kInvalidUnitBase);
+  return 1;
+}
+
+// Requires `IsAsciiWord(word)`, so the additions below never carry into the
+// next byte.
+constexpr std::uint64_t ToLowerAsciiWord(const std::uint64_t word) noexcept {
+  const std::uint64_t at_least_upper_a = word + 0x3f3f3f3f3f3f3f3f;
+  const std::uint64_t above_upper_z = word + 0x2525252525252525;
+  const std::uint64_t upper =
+      (at_least_upper_a ^ above_upper_z) & utf8_utils::detail::kWordHighBits;
+  return word | upper >> 2;
+}
+
+constexpr std::uint64_t RotateLeft(const std::uint64_t x,
+                                   const unsigned shift) noexcept {
+  return x << shift | x >> (64 - shift);
+}
+
+// Word-at-a-time hash over a byte stream. The result only depends on the bytes
+// appended, not on how they were split between `AppendByte` and `AppendWord`.
+class WordHasher {
+ public:
+  constexpr explicit WordHasher(const std::uint64_t seed) noexcept
+      : state_{seed} {}
+
+  constexpr void AppendByte(const std::uint8_t b) noexcept {
+    pending_ |= std::uint64_t{b} << pending_length_ * 8;
+    ++length_;
+    if (++pending_length_ == utf8_utils::detail::kWordSize) {
+      Mix(pending_);
+      pending_ = 0;
+      pending_length_ = 0;
+    }
+  }
+
+  constexpr void AppendWord(const std::uint64_t word) noexcept {
+    length_ += utf8_utils::detail::kWordSize;
+    if (pending_length_ == 0) {
+      Mix(word);
+      return;
+    }
+
+    const unsigned shift = pending_length_ * 8;
+    Mix(pending_ | word << shift);
+    pending_ = word >> (64 - shift);
+  }
+
+  constexpr std::uint64_t Finish() const noexcept {
+    WordHasher hasher = *this;
+    if (hasher.pending_length_ != 0) {
+      hasher.Mix(hasher.pending_);
+    }
+
+    std::uint64_t h = hasher.state_ ^ hasher.length_;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53;
+    h ^= h >> 33;
+    return h;
+  }
+
+ private:
+  constexpr void Mix(std::uint64_t word) noexcept {
+    word *= 0x87c37b91114253d5;
+    word = utf8_utils::detail::RotateLeft(word, 31);
+    word *= 0x4cf5ad432745937f;
+    state_ ^= word;
+    state_ = utf8_utils::detail::RotateLeft(state_, 27) * 5 + 0x52dce729;
+  }
+
+  std::uint64_t state_{};
+  std::uint64_t pending_{};
+  std::size_t pending_length_{};
+  std::uint64_t length_{};
+};
+
+}  // namespace detail
+
+constexpr char32_t CaseFold(const char32_t code_point) noexcept {
+  if (code_point < 0x80) {
+    return 'A' <= code_point && code_point <= 'Z' ? code_point + 0x20
+                                                  : code_point;
+  }
+
+  const auto& ranges = utf8_utils::detail::kCaseFoldRanges;
+  std::size_t lo{};
+  std::size_t hi = ranges.size();
+  while (lo < hi) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    if (ranges[mid].first <= code_point) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo == 0) {
+    return code_point;
+  }
+
+  const utf8_utils::detail::CaseFoldRange& range = ranges[lo - 1];
+  const char32_t offset = code_point - range.first;
+  if (offset % range.stride != 0 || offset / range.stride >= range.length) {
+    return code_point;
+  }
+
+  return static_cast<char32_t>(static_cast<std::int32_t>(code_point) +
+                               range.delta);
+}
+
+// A 2-byte sequence can fold to a 3-byte one (e.g. U+023A to U+2C65), which
+// is the largest growth simple case folding allows.
+constexpr std::size_t CaseFoldBufferSize(const std::size_t len) noexcept {
+  return len + len / 2;
+}
+
+// Writes the case folded `str` to `out_buffer` and returns the written length.
+// `out_buffer` must hold at least `CaseFoldBufferSize(len)` bytes. Invalid
+// bytes are copied as they are.
+inline std::size_t CaseFold(const char* str, const std::size_t len,
+                            char* out_buffer) noexcept {
+  assert(str != nullptr && "Parameter `str` must not be nullptr.");
+  assert(out_buffer != nullptr &&
+         "Parameter `out_buffer` must not be nullptr.");
+
+  std::size_t i{};
+  std::size_t out_len{};
+  while (i < len) {
+    if (len - i >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word = utf8_utils::detail::LoadWord(str + i);
+      if (utf8_utils::detail::IsAsciiWord(word)) {
+        utf8_utils::detail::StoreWord(
+            out_buffer + out_len, utf8_utils::detail::ToLowerAsciiWord(word));
+        i += utf8_utils::detail::kWordSize;
+        out_len += utf8_utils::detail::kWordSize;
+        continue;
+      }
+    }
+
+    const char32_t unit = utf8_utils::detail::DecodeUnit(str, len, i);
+    out_len += utf8_utils::detail::EncodeUnit(utf8_utils::CaseFold(unit),
+                                              out_buffer + out_len);
+  }
+
+  return out_len;
+}
+
+inline std::size_t CaseFold(std::string_view str, char* out_buffer) noexcept {
+  return utf8_utils::CaseFold(str.data(), str.size(), out_buffer);
+}
+
+inline bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+  std::size_t i{};
+  std::size_t j{};
+  while (i < a.size() && j < b.size()) {
+    if (a.size() - i >= utf8_utils::detail::kWordSize &&
+        b.size() - j >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word_a = utf8_utils::detail::LoadWord(a.data() + i);
+      const std::uint64_t word_b = utf8_utils::detail::LoadWord(b.data() + j);
+      if (utf8_utils::detail::IsAsciiWord(word_a | word_b)) {
+        if (utf8_utils::detail::ToLowerAsciiWord(word_a) !=
+            utf8_utils::detail::ToLowerAsciiWord(word_b)) {
+          return false;
+        }
+
+        i += utf8_utils::detail::kWordSize;
+        j += utf8_utils::detail::kWordSize;
+        continue;
+      }
+    }
+
+    const char32_t unit_a =
+        utf8_utils::detail::DecodeUnit(a.data(), a.size(), i);
+    const char32_t unit_b =
+        utf8_utils::detail::DecodeUnit(b.data(), b.size(), j);
+    if (utf8_utils::CaseFold(unit_a) != utf8_utils::CaseFold(unit_b)) {
+      return false;
+    }
+  }
+
+  return i == a.size() && j == b.size();
+}
+
+// Equals the hash of the `CaseFold` output, so strings that are
+// `EqualsIgnoreCase` hash the same.
+inline std::uint64_t HashFolded(std::string_view str,
+                                const std::uint64_t seed = 0) noexcept {
+  utf8_utils::detail::WordHasher hasher{seed};
+  std::size_t i{};
+  while (i < str.size()) {
+    if (str.size() - i >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word = utf8_utils::detail::LoadWord(str.data() + i);
+      if (utf8_utils::detail::IsAsciiWord(word)) {
+        hasher.AppendWord(utf8_utils::detail::ToLowerAsciiWord(word));
+        i += utf8_utils::detail::kWordSize;
+        continue;
+      }
+    }
+
+    char folded[4]{};
+    const char32_t unit =
+        utf8_utils::detail::DecodeUnit(str.data(), str.size(), i);
+    const std::size_t folded_len =
+        utf8_utils::detail::EncodeUnit(utf8_utils::CaseFold(unit), folded);
+    for (std::size_t k = 0; k < folded_len; ++k) {
+      hasher.AppendByte(folded[k]);
+    }
+  }
+
+  return hasher.Finish();
+}
+
+inline std::uint64_t Hash(std::string_view str,
+                          const std::uint64_t seed = 0) noexcept {
+  utf8_utils::detail::WordHasher hasher{seed};
+  std::size_t i{};
+  for (; str.size() - i >= utf8_utils::detail::kWordSize;
+       i += utf8_utils::detail::kWordSize) {
+    hasher.AppendWord(utf8_utils::detail::LoadWord(str.data() + i));
+  }
+
+  for (; i < str.size(); ++i) {
+    hasher.AppendByte(str[i]);
+  }
+
+  return hasher.Finish();
+}
+
+struct CheckAndHashResult {
+  std::optional<utf8_utils::CheckError> error;
+  std::uint64_t hash{};
+};
+
+namespace detail {
+
+// Hashes the checked bytes `[hashed, checked)` a word at a time, leaving less
+// than a word for the next call.
+inline void HashCheckedWords(const char* str,
+                             utf8_utils::detail::WordHasher& hasher,
+                             std::size_t& hashed,
+                             const std::size_t checked) noexcept {
+  for (; checked - hashed >= utf8_utils::detail::kWordSize;
+       hashed += utf8_utils::detail::kWordSize) {
+    hasher.AppendWord(utf8_utils::detail::LoadWord(str + hashed));
+  }
+}
+
+}  // namespace detail
+
+// Fuses `Check` and `Hash` into a single pass. On error, `hash` covers the
+// bytes before `error->invalid_position`.
+template <typename StatsPolicy = utf8_utils::NoStats>
+utf8_utils::CheckAndHashResult CheckAndHash(
+    const char* str, const std::size_t len,
+    const std::uint64_t seed = 0) noexcept {
+  utf8_utils::detail::ScanRecorder<StatsPolicy> recorder{};
+  utf8_utils::detail::WordHasher hasher{seed};
+  if (str == nullptr) {
+    const utf8_utils::CheckError err{utf8_utils::ErrorCode::kNullStringPtr, 0,
+                                     0};
+    recorder.OnError(err);
+    recorder.Finish(0);
+    return {err, hasher.Finish()};
+  }
+
+  // Bytes are hashed a word at a time once they are checked, so the hasher
+  // never falls back to `AppendByte` except for the last partial word.
+  std::optional<utf8_utils::CheckError> err;
+  std::size_t i{};
+  std::size_t hashed{};
+  while (i < len) {
+    if (len - i >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word = utf8_utils::detail::LoadWord(str + i);
+      if (utf8_utils::detail::IsAsciiWord(word)) {
+        recorder.OnAsciiRun(utf8_utils::detail::kWordSize);
+        i += utf8_utils::detail::kWordSize;
+        if (hashed + utf8_utils::detail::kWordSize == i) {
+          hasher.AppendWord(word);
+          hashed = i;
+        } else {
+          utf8_utils::detail::HashCheckedWords(str, hasher, hashed, i);
+        }
+
+        continue;
+      }
+
+      // Skips the ASCII bytes in front of the first non-ASCII one.
+      const std::size_t ascii_length =
+          utf8_utils::detail::AsciiPrefixLength(word);
+      recorder.OnAsciiRun(ascii_length);
+      i += ascii_length;
+    }
+
+    const std::size_t start = i;
+    if (err = utf8_utils::detail::CheckSequence(str, len, i); err) {
+      recorder.OnError(*err);
+      i = err->invalid_position;
+      break;
+    }
+
+    recorder.OnSequence(i - start);
+    utf8_utils::detail::HashCheckedWords(str, hasher, hashed, i);
+  }
+
+  for (; hashed < i; ++hashed) {
+    hasher.AppendByte(str[hashed]);
+  }
+
+  recorder.Finish(err ? err->invalid_position + err->invalid_length : len,
+                  utf8_utils::detail::WordLoopPath(len));
+  return {err, hasher.Finish()};
+}
+
+template <typename StatsPolicy = utf8_utils::NoStats>
+utf8_utils::CheckAndHashResult CheckAndHash(
+    std::string_view str, const std::uint64_t seed = 0) noexcept {
+  return utf8_utils::CheckAndHash<StatsPolicy>(str.data(), str.size(), seed);
+}
+
+// Inputs of at least this size are assumed not to fit in L2, so
+// `CheckAndCopy` writes them with non-temporal stores to keep the destination
+// from evicting the source.
+constexpr std::size_t kNonTemporalCopyThreshold = 1 << 20;
+
+namespace detail {
+
+template <typename Recorder>
+std::optional<utf8_utils::CheckError> CheckAndCopyScalar(
+    const char* str, const std::size_t len, char* out_buffer,
+    Recorder& recorder) noexcept {
+  std::size_t i{};
+  while (i < len) {
+    if (len - i >= utf8_utils::detail::kWordSize) {
+      const std::uint64_t word = utf8_utils::detail::LoadWord(str + i);
+      if (utf8_utils::detail::IsAsciiWord(word)) {
+        utf8_utils::detail::StoreWord(out_buffer + i, word);
+        recorder.OnAsciiRun(utf8_utils::detail::kWordSize);
+        i += utf8_utils::detail::kWordSize;
+        continue;
+      }
+    }
+
+    const std::size_t start = i;
+    if (auto err = utf8_utils::detail::CheckSequence(str, len, i); err) {
+      recorder.OnError(*err);
+      recorder.Finish(i, utf8_utils::detail::WordLoopPath(len));
+      return err;
+    }
+
+    recorder.OnSequence(i - start);
+    std::memcpy(out_buffer + start, str + start, i - start);
+  }
+
+  recorder.Finish(len, utf8_utils::detail::WordLoopPath(len));
+  return std::nullopt;
+}
+
+#if defined(__SSE2__)
+
+constexpr std::size_t kBlockSize = sizeof(__m128i);
+
+// Copies the checked bytes `[copied, checked)` with aligned non-temporal
+// stores, leaving less than a block for the next call.
+inline void StreamCopyBlocks(const char* str, char* out_buffer,
+                             std::size_t& copied,
+                             const std::size_t checked) noexcept {
+  while (checked - copied >= utf8_utils::detail::kBlockSize) {
+    const std::size_t misalignment =
+        reinterpret_cast<std::uintptr_t>(out_buffer + copied) %
+        utf8_utils::detail::kBlockSize;
+    if (misalignment != 0) {
+      const std::size_t head = utf8_utils::detail::kBlockSize - misalignment;
+      std::memcpy(out_buffer + copied, str + copied, head);
+      copied += head;
+      continue;
+    }
+
+    _mm_stream_si128(
+        reinterpret_cast<__m128i*>(out_buffer + copied),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + copied)));
+    copied += utf8_utils::detail::kBlockSize;
+  }
+}
+
+template <typename Recorder>
+std::optional<utf8_utils::CheckError> CheckAndCopyStream(
+    const char* str, const std::size_t len, char* out_buffer,
+    Recorder& recorder) noexcept {
+  std::optional<utf8_utils::CheckError> err;
+  std::size_t i{};
+  std::size_t copied{};
+  while (i < len) {
+    if (len - i >= utf8_utils::detail::kBlockSize) {
+      const __m128i block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+      if (_mm_movemask_epi8(block) == 0) {
+        recorder.OnAsciiRun(utf8_utils::detail::kBlockSize);
+        i += utf8_utils::detail::kBlockSize;
+        utf8_utils::detail::StreamCopyBlocks(str, out_buffer, copied, i);
+        continue;
+      }
+    }
+
+    const std::size_t start = i;
+    if (err = utf8_utils::detail::CheckSequence(str, len, i); err) {
+      recorder.OnError(*err);
+      recorder.Finish(i, utf8_utils::DispatchPath::kSse2);
+      i = err->invalid_position;
+      break;
+    }
+
+    recorder.OnSequence(i - start);
+    utf8_utils::detail::StreamCopyBlocks(str, out_buffer, copied, i);
+  }
+
+  std::memcpy(out_buffer + copied, str + copied, i - copied);
+  _mm_sfence();
+  if (!err) {
+    recorder.Finish(len, utf8_utils::DispatchPath::kSse2);
+  }
+
+  return err;
+}
+
+#endif  // defined(__SSE2__)
+
+}  // namespace detail
+
+// Fuses `Check` with copying `str` to `out_buffer`, which must hold at least
+// `len` bytes. On error, only the bytes before `invalid_position` are copied.
+template <typename StatsPolicy = utf8_utils::NoStats>
+std::optional<utf8_utils::CheckError> CheckAndCopy(
+    const char* str, const std::size_t len, char* out_buffer) noexcept {
+  utf8_utils::detail::ScanRecorder<StatsPolicy> recorder{};
+  if (str == nullptr) {
+    const utf8_utils::CheckError err{utf8_utils::ErrorCode::kNullStringPtr, 0,
+                                     0};
+    recorder.OnError(err);
+    recorder.Finish(0);
+    return err;
+  }
+
+  assert(out_buffer != nullptr &&
+         "Parameter `out_buffer` must not be nullptr.");
+
+#if defined(__SSE2__)
+  if (len >= utf8_utils::kNonTemporalCopyThreshold) {
+    return utf8_utils::detail::CheckAndCopyStream(str, len, out_buffer,
+                                                  recorder);
+  }
+#endif
+
+  return utf8_utils::detail::CheckAndCopyScalar(str, len, out_buffer,
+                                                recorder);
+}
+
+template <typename StatsPolicy = utf8_utils::NoStats>
+std::optional<utf8_utils::CheckError> CheckAndCopy(std::string_view str,
+                                                   char* out_buffer) noexcept {
+  return utf8_utils::CheckAndCopy<StatsPolicy>(str.data(), str.size(),
+                                               out_buffer);
 }
 
 }  // namespace utf8_utils